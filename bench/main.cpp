@@ -0,0 +1,280 @@
+#include <fmt/core.h>
+#include <linux/perf_event.h>
+#include <spdlog/spdlog.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "exe/Exe.hpp"
+#include "net/ClientEndpoint.hpp"
+#include "net/FrameClientEndpoint.hpp"
+#include "net/FrameServerEndpoint.hpp"
+#include "net/Ingest.hpp"
+#include "net/ServerEndpoint.hpp"
+#include "net/Storage.hpp"
+#include "po/ProgramOptions.hpp"
+
+// Uploads the same synthetic frame over loopback with the client and server endpoints running in one process and
+// reports throughput, per frame latency and system calls per frame. Built once per I/O backend (bench_epoll,
+// bench_uring), so both can be compared on the same workload.
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+  using Clock    = std::chrono::steady_clock;
+
+#if defined(BOOST_ASIO_HAS_IO_URING)
+  constexpr const char* Backend = "io_uring";
+#else
+  constexpr const char* Backend = "epoll";
+#endif
+
+  struct BenchOptions
+  {
+    std::size_t frames;
+    std::size_t frameSize;
+    std::uint16_t port;
+    bool binary;
+    fs::path workDir;
+
+    void addOptions(boost_po::options_description& description)
+    {
+      // clang-format off
+      description.add_options()
+      ("frames", boost_po::value<std::size_t>(&frames)->default_value(2000), "Number of uploaded frames")
+      ("size", boost_po::value<std::size_t>(&frameSize)->default_value(256 * 1024), "Frame size [bytes]")
+      ("port", boost_po::value<std::uint16_t>(&port)->default_value(18400), "Loopback port")
+      ("binary", boost_po::bool_switch(&binary), "Use the binary framing protocol instead of HTTP")
+      ("workdir", boost_po::value<fs::path>(&workDir)->default_value(fs::temp_directory_path() / "camera_asio_bench"), "Scratch directory, each run works in its own subdirectory");
+      // clang-format on
+    }
+  };
+
+  // Counts system calls of all threads created after construction (raw_syscalls:sys_enter tracepoint).
+  // Needs tracefs and a permissive perf_event_paranoid, otherwise no count is reported.
+  struct SyscallCounter
+  {
+    SyscallCounter()
+    {
+      for (const auto* tracefs : { "/sys/kernel/tracing", "/sys/kernel/debug/tracing" })
+      {
+        std::ifstream idFile{ fmt::format("{}/events/raw_syscalls/sys_enter/id", tracefs) };
+        std::uint64_t id;
+        if (!(idFile >> id))
+        {
+          continue;
+        }
+
+        perf_event_attr attr{};
+        attr.type          = PERF_TYPE_TRACEPOINT;
+        attr.size          = sizeof(attr);
+        attr.config        = id;
+        attr.disabled      = 1;
+        attr.inherit       = 1;
+        attr.exclude_guest = 1;
+
+        _fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        break;
+      }
+    }
+
+    ~SyscallCounter()
+    {
+      if (_fd >= 0)
+      {
+        ::close(_fd);
+      }
+    }
+
+    void start() const
+    {
+      if (_fd >= 0)
+      {
+        ::ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+
+    std::optional<std::uint64_t> stop() const
+    {
+      std::uint64_t count;
+      if (_fd < 0 || ::ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0) != 0 || ::read(_fd, &count, sizeof(count)) != sizeof(count))
+      {
+        return std::nullopt;
+      }
+
+      return count;
+    }
+
+  private:
+    int _fd = -1;
+  };
+
+  // The bench only works in (and removes) its own subdirectory of --workdir.
+  fs::path makeRunDir(const BenchOptions& opts)
+  {
+    auto runDir = opts.workDir / fmt::format("run-{}", ::getpid());
+    fs::create_directories(runDir);
+    return runDir;
+  }
+
+  fs::path makeFrame(const BenchOptions& opts, const fs::path& runDir)
+  {
+    auto path = runDir / "frame.jpg";
+
+    std::string data(opts.frameSize, '\0');
+    std::mt19937 random{ 42 };
+    std::generate(data.begin(), data.end(), [&random] { return static_cast<char>(random()); });
+    std::ofstream{ path, std::ios::binary }.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+    return path;
+  }
+
+  template<typename Client>
+  asio::awaitable<void> upload(Client& client, fs::path frame, std::size_t frames, std::vector<double>& latencies)
+  {
+    for (std::size_t i = 0; i < frames; ++i)
+    {
+      const auto start = Clock::now();
+      co_await client.sendFile(frame);
+      latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+  }
+
+  double percentile(std::vector<double>& sorted, double p)
+  {
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())))];
+  }
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  BenchOptions opts;
+  if (!po::parse(argc, argv, opts))
+  {
+    return EXIT_FAILURE;
+  }
+
+  spdlog::set_level(spdlog::level::warn);
+
+  const bool ownWorkDir = !fs::exists(opts.workDir);
+  const auto runDir     = makeRunDir(opts);
+  const auto frame      = makeFrame(opts, runDir);
+  net::Storage storage{ runDir / "out", 256 };
+  net::Ingest ingest{ storage };
+
+  SyscallCounter syscalls;
+
+  asio::io_context serverIo;
+  std::optional<net::ServerEndpoint> httpServer;
+  std::optional<net::FrameServerEndpoint> frameServer;
+  if (opts.binary)
+  {
+    frameServer.emplace(serverIo.get_executor(), ingest, tcp::endpoint{ tcp::v4(), opts.port }, 30);
+    exe::submit(serverIo.get_executor(), frameServer->doListen());
+  }
+  else
+  {
+    httpServer.emplace(serverIo.get_executor(), ingest, opts.port, 30);
+    exe::submit(serverIo.get_executor(), httpServer->doListen());
+  }
+
+  std::jthread serverThread{ [&serverIo] { serverIo.run(); } };
+
+  // ClientEndpoint prints every response.
+  std::ostringstream discard;
+  auto* coutBuffer = std::cout.rdbuf(discard.rdbuf());
+
+  asio::io_context clientIo;
+  std::vector<double> latencies;
+  latencies.reserve(opts.frames);
+
+  syscalls.start();
+  const auto start = Clock::now();
+
+  if (opts.binary)
+  {
+    // A window of one, so that every send waits for its ack like an HTTP request waits for its response.
+    net::FrameClientEndpoint client{ clientIo.get_executor(), "127.0.0.1", std::to_string(opts.port), 30, 0, 1 };
+    asio::co_spawn(clientIo, upload(client, frame, opts.frames, latencies), asio::detached);
+    clientIo.run();
+  }
+  else
+  {
+    net::ClientEndpoint client{ clientIo.get_executor(), "127.0.0.1", std::to_string(opts.port), 30 };
+    asio::co_spawn(clientIo, upload(client, frame, opts.frames, latencies), asio::detached);
+    clientIo.run();
+  }
+
+  const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  const auto calls   = syscalls.stop();
+
+  std::cout.rdbuf(coutBuffer);
+
+  asio::post(serverIo,
+             [&]
+             {
+               if (httpServer)
+                 httpServer->cancel();
+               if (frameServer)
+                 frameServer->cancel();
+               serverIo.stop();
+             });
+  serverThread.join();
+
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+
+  if (latencies.empty())
+  {
+    fmt::print(stderr, "No frame was uploaded\n");
+    return EXIT_FAILURE;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const auto uploaded = static_cast<double>(latencies.size());
+
+  fmt::print("backend:            {}\n", Backend);
+  fmt::print("protocol:           {}\n", opts.binary ? "binary" : "http");
+  fmt::print("frames:             {} x {} bytes\n", latencies.size(), opts.frameSize);
+  fmt::print("throughput:         {:.1f} frames/s, {:.1f} MiB/s\n",
+             uploaded / elapsed,
+             uploaded * static_cast<double>(opts.frameSize) / elapsed / (1024 * 1024));
+  fmt::print("latency [us]:       p50 {:.0f}, p99 {:.0f}, max {:.0f}\n",
+             percentile(latencies, 0.5),
+             percentile(latencies, 0.99),
+             latencies.back());
+  if (calls)
+  {
+    fmt::print("syscalls/frame:     {:.1f}\n", static_cast<double>(*calls) / uploaded);
+  }
+  else
+  {
+    fmt::print("syscalls/frame:     n/a (needs tracefs and perf_event_paranoid <= 1, or run under `strace -fc`)\n");
+  }
+  fmt::print("ctx switches/frame: {:.2f}\n", static_cast<double>(usage.ru_nvcsw + usage.ru_nivcsw) / uploaded);
+
+  fs::remove_all(runDir);
+  if (ownWorkDir)
+  {
+    // Not if other runs still use it.
+    std::error_code ec;
+    fs::remove(opts.workDir, ec);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -8,21 +8,27 @@
 #include "dir/Monitor.hpp"
 #include "exe/Exe.hpp"
 #include "gst/Camera.hpp"
+#include "img/Jpeg.hpp"
+#include "logging/Logging.hpp"
+#include "net/ChunkQueue.hpp"
 #include "net/ClientEndpoint.hpp"
+#include "net/FrameClientEndpoint.hpp"
+#include "net/ShmClientEndpoint.hpp"
+#include "net/Spool.hpp"
 #include "po/ProgramOptions.hpp"
 
 namespace
 {
   namespace asio = boost::asio;
   namespace fs   = std::filesystem;
+  using Clock    = std::chrono::steady_clock;
 }  // namespace
 
-boost::asio::awaitable<void> uploadImages(const po::ClientOptions& opts)
+boost::asio::awaitable<void> uploadImages(auto& endpoint, const po::ClientOptions& opts)
 {
   auto executor = co_await asio::this_coro::executor;
   auto state    = co_await asio::this_coro::cancellation_state;
 
-  net::ClientEndpoint endpoint{ executor, opts.serverIp, std::to_string(opts.serverPort), opts.timeout };
   dir::Monitor monitor{ executor, opts.outDir, IN_MOVED_TO };
 
   while (true)
@@ -41,16 +47,175 @@ boost::asio::awaitable<void> uploadImages(const po::ClientOptions& opts)
   }
 }
 
+boost::asio::awaitable<void> spoolImages(net::Spool& spool, Timer& added, const po::ClientOptions& opts)
+{
+  auto executor = co_await asio::this_coro::executor;
+  auto state    = co_await asio::this_coro::cancellation_state;
+
+  dir::Monitor monitor{ executor, opts.outDir, IN_MOVED_TO };
+
+  while (true)
+  {
+    fs::path imagePath = co_await monitor.getNewImage1();
+    if (!imagePath.empty())
+    {
+      spool.add(std::move(imagePath));
+      added.cancel();
+    }
+
+    if (state.cancelled() != asio::cancellation_type::none)
+    {
+      spdlog::critical("Canceling spoolImages coroutine...");
+      co_return;
+    }
+  }
+}
+
+// Sends the spooled frames in order. A failed upload is retried with backoff and resumed where it broke off, a frame
+// the server rejects is dropped. A backlog (e.g. after an outage) goes out back to back over one connection, paced to
+// --catchuprate, while a single fresh frame is sent right away.
+boost::asio::awaitable<void> drainSpool(net::ClientEndpoint& endpoint,
+                                        net::Spool& spool,
+                                        Timer& added,
+                                        const po::ClientOptions& opts)
+{
+  auto executor = co_await asio::this_coro::executor;
+  auto state    = co_await asio::this_coro::cancellation_state;
+
+  constexpr std::chrono::seconds MaxBackoff{ 30 };
+  std::chrono::seconds backoff{ 1 };
+  auto nextSend = Clock::now();
+  Timer pause{ executor };
+
+  while (state.cancelled() == asio::cancellation_type::none)
+  {
+    if (spool.empty())
+    {
+      // Servers drop idle connections, the next frame connects anew.
+      endpoint.disconnect();
+      co_await added.async_wait();
+      continue;
+    }
+
+    auto& entry = spool.front();
+    if (!fs::exists(entry.path))
+    {
+      spdlog::warn("Dropping spooled frame {}, its file is gone", entry.path);
+      spool.done();
+      continue;
+    }
+
+    if (opts.catchUpRate > 0 && spool.size() > 1 && Clock::now() < nextSend)
+    {
+      pause.expires_at(nextSend);
+      co_await pause.async_wait();
+      continue;
+    }
+
+    bool failed = false;
+    try
+    {
+      const auto sent = co_await endpoint.sendResumable(entry.uploadId, entry.path, opts.sourceId, entry.attempted);
+      spool.done();
+      backoff = std::chrono::seconds{ 1 };
+
+      if (opts.catchUpRate > 0)
+      {
+        const std::chrono::duration<double> cost{ static_cast<double>(sent) / (opts.catchUpRate * 1024 * 1024) };
+        nextSend = std::max(nextSend, Clock::now()) + std::chrono::duration_cast<Clock::duration>(cost);
+      }
+    }
+    catch (const net::UploadRejected& ex)
+    {
+      spdlog::error("Server rejected spooled frame {}, dropping it: {}", entry.path, ex.what());
+      spool.done();
+      continue;
+    }
+    catch (const std::exception& ex)
+    {
+      failed          = true;
+      entry.attempted = true;
+      if (state.cancelled() == asio::cancellation_type::none)
+      {
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 },
+                              "Upload of {} failed, {} frames spooled: {}",
+                              entry.path,
+                              spool.size(),
+                              ex.what());
+      }
+    }
+
+    if (failed && state.cancelled() == asio::cancellation_type::none)
+    {
+      pause.expires_after(backoff);
+      co_await pause.async_wait();
+      backoff = std::min(backoff * 2, MaxBackoff);
+    }
+  }
+
+  spdlog::critical("Canceling drainSpool coroutine...");
+}
+
+boost::asio::awaitable<void> uploadImages(const po::ClientOptions& opts)
+{
+  auto executor = co_await asio::this_coro::executor;
+
+  if (!opts.shmPath.empty())
+  {
+    net::ShmClientEndpoint endpoint{ executor, opts.shmPath, opts.timeout, opts.sourceId };
+    co_await uploadImages(endpoint, opts);
+  }
+  else if (!opts.unixPath.empty())
+  {
+    net::LocalFrameClientEndpoint endpoint{ executor, opts.unixPath.string(), "", opts.timeout, opts.sourceId };
+    co_await uploadImages(endpoint, opts);
+  }
+  else if (opts.binary)
+  {
+    net::FrameClientEndpoint endpoint{
+      executor, opts.serverIp, std::to_string(opts.serverPort), opts.timeout, opts.sourceId
+    };
+    co_await uploadImages(endpoint, opts);
+  }
+  else if (!opts.spoolDir.empty())
+  {
+    net::Spool spool{ opts.spoolDir };
+    if (!spool.empty())
+    {
+      spdlog::info("Resuming {} spooled frames", spool.size());
+    }
+
+    net::ClientEndpoint endpoint{ executor, opts.serverIp, std::to_string(opts.serverPort), opts.timeout };
+    Timer added{ executor, Timer::time_point::max() };
+    co_await exe::whenAll(spoolImages(spool, added, opts), drainSpool(endpoint, spool, added, opts));
+  }
+  else
+  {
+    net::ClientEndpoint endpoint{ executor, opts.serverIp, std::to_string(opts.serverPort), opts.timeout };
+    co_await uploadImages(endpoint, opts);
+  }
+}
+
 boost::asio::awaitable<void> takeCameraShots(const po::ClientOptions& opts)
 {
   auto executor = co_await asio::this_coro::executor;
   auto state    = co_await asio::this_coro::cancellation_state;
 
-  gst::Camera camera{ executor, opts.videoDevice, opts.outDir };
+  const bool burst = opts.burstCount > 0;
+  gst::Camera camera{ executor, opts.videoDevice, opts.outDir, burst ? gst::CaptureMode::Burst : gst::CaptureMode::Single };
 
   while (true)
   {
-    gst::PipelineMessage msg = co_await camera.take1();
+    gst::PipelineMessage msg = gst::PipelineMessage::Idle;
+    if (burst)
+    {
+      auto result = co_await camera.takeBurst(opts.burstCount, std::chrono::milliseconds{ opts.burstInterval });
+      msg         = result.status;
+    }
+    else
+    {
+      msg = co_await camera.take1();
+    }
 
     if (state.cancelled() != asio::cancellation_type::none)
     {
@@ -66,13 +231,82 @@ boost::asio::awaitable<void> takeCameraShots(const po::ClientOptions& opts)
   }
 }
 
+// Captures raw frames and uploads each one while it is encoded, so the first chunks are on the wire
+// before the encoder has finished. Nothing is written to the output directory, so a frame that fails
+// to upload is lost; the next one is taken after a backoff.
+boost::asio::awaitable<void> streamCameraShots(const po::ClientOptions& opts)
+{
+  auto executor = co_await asio::this_coro::executor;
+  auto state    = co_await asio::this_coro::cancellation_state;
+
+  gst::Camera camera{ executor, opts.videoDevice, opts.outDir, gst::CaptureMode::Raw };
+  net::ClientEndpoint endpoint{ executor, opts.serverIp, std::to_string(opts.serverPort), opts.timeout };
+  asio::thread_pool encoder{ 1 };
+
+  constexpr std::chrono::seconds MaxBackoff{ 30 };
+  std::chrono::seconds backoff{ 1 };
+  Timer pause{ executor };
+
+  while (true)
+  {
+    auto image  = std::make_shared<const img::Image>(co_await camera.takeRaw());
+    auto chunks = std::make_shared<net::ChunkQueue>(executor);
+
+    asio::post(encoder,
+               [image, chunks]
+               {
+                 try
+                 {
+                   img::encodeStreaming(*image, [&chunks](std::string_view chunk) { chunks->push(std::string{ chunk }); });
+                   chunks->close();
+                 }
+                 catch (...)
+                 {
+                   chunks->close(std::current_exception());
+                 }
+               });
+
+    bool failed = false;
+    try
+    {
+      co_await endpoint.sendChunked(chunks);
+      backoff = std::chrono::seconds{ 1 };
+    }
+    catch (const std::exception& ex)
+    {
+      failed = true;
+      LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Streamed upload failed, dropping the frame: {}", ex.what());
+    }
+
+    if (state.cancelled() != asio::cancellation_type::none)
+    {
+      spdlog::critical("Canceling streamCameraShots coroutine...");
+      co_return;
+    }
+
+    if (failed)
+    {
+      pause.expires_after(backoff);
+      co_await pause.async_wait();
+      backoff = std::min(backoff * 2, MaxBackoff);
+    }
+  }
+}
+
 asio::awaitable<void> asyncMain(const po::ClientOptions& opts)
 {
   spdlog::info("Starting the async main...");
 
   try
   {
-    co_await exe::whenAll(takeCameraShots(opts), uploadImages(opts));
+    if (opts.stream)
+    {
+      co_await streamCameraShots(opts);
+    }
+    else
+    {
+      co_await exe::whenAll(takeCameraShots(opts), uploadImages(opts));
+    }
   }
   catch (const std::exception& ex)
   {
@@ -94,6 +328,12 @@ int main(int argc, char* argv[])
       return EXIT_FAILURE;
     }
 
+    logging::init(opts.logFile);
+    if (!opts.traceFile.empty())
+    {
+      exe::trace::enable();
+    }
+
     gst_init(nullptr, nullptr);
 
     asio::io_context io;
@@ -101,12 +341,19 @@ int main(int argc, char* argv[])
     exe::whenOneOf(io, asyncMain(opts), exe::stopOnSignals(SIGINT), exe::stopAfter(opts.recTime));
 
     io.run();
+
+    if (!opts.traceFile.empty())
+    {
+      exe::trace::exportChromeJson(opts.traceFile);
+    }
   }
   catch (const std::exception& e)
   {
     spdlog::error("{}", e.what());
+    logging::shutdown();
     return EXIT_FAILURE;
   }
 
+  logging::shutdown();
   return EXIT_SUCCESS;
 }
\ No newline at end of file
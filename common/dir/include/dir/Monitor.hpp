@@ -8,6 +8,7 @@
 #include <filesystem>
 
 #include "exe/Exe.hpp"
+#include "exe/Trace.hpp"
 
 namespace
 {
@@ -26,7 +27,8 @@ namespace dir
           _streamDesc{ executor, inotify_init() },
           _buf{ 1024 },
           _mask{ mask },
-          _wd{ inotify_add_watch(_streamDesc.native_handle(), _listenDir.c_str(), _mask) }
+          _wd{ inotify_add_watch(_streamDesc.native_handle(), _listenDir.c_str(), _mask) },
+          _traceId{ exe::trace::newId() }
     {
       if (!fs::exists(_listenDir))
       {
@@ -37,6 +39,7 @@ namespace dir
     asio::awaitable<fs::path> getNewImage1()
     {
       fs::path retPath = "";
+      exe::trace::Span span{ "inotify_wait", _traceId };
 
       try
       {
@@ -74,6 +77,7 @@ namespace dir
     asio::streambuf _buf;
     int _mask;
     int _wd;
+    std::uint64_t _traceId;
   };
 
 }  // namespace dir
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <boost/asio.hpp>
 #include <boost/asio/experimental/awaitable_operators.hpp>
 
+#include "exe/Trace.hpp"
+#include "logging/Logging.hpp"
+
 namespace
 {
   namespace asio = boost::asio;
@@ -38,12 +41,12 @@ namespace exe
 
     if constexpr (std::is_void_v<returnType>)
     {
-      asio::co_spawn(executor, std::forward<Awaitable>(awaitable),
+      asio::co_spawn(executor, trace::maybeTraced("submit", std::forward<Awaitable>(awaitable)),
                      [](std::exception_ptr excPtr, auto...)
                      {
                        if (excPtr)
                        {
-                         spdlog::error("Exception thrown from coroutine!");
+                         LOG_ERROR_RATE_LIMITED(std::chrono::seconds{ 1 }, "Exception thrown from coroutine!");
                          std::rethrow_exception(excPtr);
                        }
                      });
@@ -55,7 +58,7 @@ namespace exe
   {
     auto executor = co_await asio::this_coro::executor;
 
-    co_await asio::co_spawn(executor, std::forward<Awaitable>(awaitable), asio::use_awaitable);
+    co_await asio::co_spawn(executor, trace::maybeTraced("submit", std::forward<Awaitable>(awaitable)), asio::use_awaitable);
   }
 
   template<AwaitableType... Awaitable>
@@ -77,7 +80,8 @@ namespace exe
   {
     auto executor = co_await asio::this_coro::executor;
 
-    co_await asio::co_spawn(executor, (std::forward<Awaitable>(awaitables) && ...), asio::use_awaitable);
+    co_await asio::co_spawn(executor, (trace::maybeTraced("whenAll", std::forward<Awaitable>(awaitables)) && ...),
+                            asio::use_awaitable);
   }
 
   asio::awaitable<void> stopAfter(std::int64_t timeout)
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "exe/Exe.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+}  // namespace
+
+namespace exe
+{
+  // Hierarchical timing wheel for coarse connection deadlines (idle/read/write timeouts).
+  // Arming, re-arming and disarming an entry are O(1) and never touch the io_context timer queue;
+  // a single steady_timer ticks the wheel and only runs while at least one entry is armed.
+  // Not thread-safe: entries have to be armed and disarmed from the executor the wheel runs on.
+  struct TimerWheel
+  {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+      Entry() = default;
+      explicit Entry(std::function<void()> onExpire) : _onExpire{ std::move(onExpire) } { }
+
+      Entry(const Entry&)            = delete;
+      Entry& operator=(const Entry&) = delete;
+
+      ~Entry() noexcept
+      {
+        if (_wheel)
+        {
+          _wheel->disarm(*this);
+        }
+      }
+
+      void onExpire(std::function<void()> handler) { _onExpire = std::move(handler); }
+
+      bool armed() const noexcept { return _pprev != nullptr; }
+      bool expired() const noexcept { return _expired; }
+
+    private:
+      friend struct TimerWheel;
+
+      std::function<void()> _onExpire;
+      TimerWheel* _wheel = nullptr;
+      Entry* _next       = nullptr;
+      Entry** _pprev     = nullptr;
+      std::uint64_t _expiry = 0;
+      bool _expired         = false;
+    };
+
+    TimerWheel(const exe::Executor auto& executor, Clock::duration resolution = std::chrono::milliseconds{ 250 })
+        : _timer{ executor }, _resolution{ resolution }, _epoch{ Clock::now() }
+    {
+    }
+
+    TimerWheel(const TimerWheel&)            = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    ~TimerWheel() noexcept
+    {
+      for (auto& level : _levels)
+      {
+        for (auto& slot : level)
+        {
+          while (slot)
+          {
+            Entry* entry = slot;
+            unlink(*entry);
+            entry->_wheel = nullptr;
+          }
+        }
+      }
+    }
+
+    // (Re)arms the entry to expire after at least `timeout`, at most one tick later.
+    void arm(Entry& entry, Clock::duration timeout)
+    {
+      if (entry.armed())
+      {
+        unlink(entry);
+      }
+      else
+      {
+        if (_size++ == 0)
+        {
+          start();
+        }
+      }
+
+      const auto ticks = (timeout + _resolution - Clock::duration{ 1 }) / _resolution;
+      entry._wheel     = this;
+      entry._expired   = false;
+      entry._expiry    = _now + static_cast<std::uint64_t>(std::max<Clock::duration::rep>(ticks, 0)) + 1;
+      place(entry);
+    }
+
+    // Also clears the expired flag, so the entry can be reused for the next operation.
+    void disarm(Entry& entry) noexcept
+    {
+      entry._expired = false;
+      if (!entry.armed())
+      {
+        return;
+      }
+
+      unlink(entry);
+      --_size;
+    }
+
+    std::size_t size() const noexcept { return _size; }
+
+  private:
+    static constexpr std::size_t SlotBits = 6;
+    static constexpr std::size_t Slots    = std::size_t{ 1 } << SlotBits;
+    static constexpr std::size_t Levels   = 4;
+
+    using Slot = Entry*;
+
+    void place(Entry& entry) noexcept
+    {
+      const std::uint64_t delta = entry._expiry > _now ? entry._expiry - _now : 0;
+
+      std::size_t level = 0;
+      while (level + 1 < Levels && delta >= (std::uint64_t{ 1 } << (SlotBits * (level + 1))))
+      {
+        ++level;
+      }
+
+      // Deadlines past the last level are parked in its furthest slot and re-placed on cascade.
+      std::uint64_t expiry = entry._expiry;
+      const std::uint64_t horizon = std::uint64_t{ 1 } << (SlotBits * Levels);
+      if (delta >= horizon)
+      {
+        expiry = _now + horizon - 1;
+      }
+
+      link(_levels[level][(expiry >> (SlotBits * level)) & (Slots - 1)], entry);
+    }
+
+    static void link(Slot& head, Entry& entry) noexcept
+    {
+      entry._next = head;
+      if (head)
+      {
+        head->_pprev = &entry._next;
+      }
+      head         = &entry;
+      entry._pprev = &head;
+    }
+
+    static void unlink(Entry& entry) noexcept
+    {
+      *entry._pprev = entry._next;
+      if (entry._next)
+      {
+        entry._next->_pprev = entry._pprev;
+      }
+      entry._next  = nullptr;
+      entry._pprev = nullptr;
+    }
+
+    std::uint64_t clockTicks() const { return static_cast<std::uint64_t>((Clock::now() - _epoch) / _resolution); }
+
+    void start()
+    {
+      // Nothing is armed, so the wheel can jump straight to the current time.
+      _now = clockTicks();
+      schedule();
+    }
+
+    void schedule()
+    {
+      _timer.expires_at(_epoch + _resolution * static_cast<Clock::duration::rep>(_now + 1));
+      _timer.async_wait(
+          [this](boost::system::error_code ec)
+          {
+            if (ec)
+            {
+              return;
+            }
+
+            const std::uint64_t target = clockTicks();
+            while (_now < target && _size > 0)
+            {
+              tick();
+            }
+
+            if (_size > 0)
+            {
+              schedule();
+            }
+          });
+    }
+
+    void tick()
+    {
+      ++_now;
+
+      for (std::size_t level = 1; level < Levels; ++level)
+      {
+        if ((_now & ((std::uint64_t{ 1 } << (SlotBits * level)) - 1)) != 0)
+        {
+          break;
+        }
+
+        Slot pending = nullptr;
+        splice(_levels[level][(_now >> (SlotBits * level)) & (Slots - 1)], pending);
+        while (pending)
+        {
+          Entry* entry = pending;
+          unlink(*entry);
+          place(*entry);
+        }
+      }
+
+      Slot expired = nullptr;
+      splice(_levels[0][_now & (Slots - 1)], expired);
+
+      // Handlers may re-arm or destroy any entry, including ones still queued here.
+      while (expired)
+      {
+        Entry* entry = expired;
+        unlink(*entry);
+        --_size;
+        entry->_expired = true;
+        if (entry->_onExpire)
+        {
+          entry->_onExpire();
+        }
+      }
+    }
+
+    static void splice(Slot& from, Slot& to) noexcept
+    {
+      to   = from;
+      from = nullptr;
+      if (to)
+      {
+        to->_pprev = &to;
+      }
+    }
+
+    asio::steady_timer _timer;
+    Clock::duration _resolution;
+    Clock::time_point _epoch;
+    std::uint64_t _now = 0;
+    std::size_t _size  = 0;
+    std::array<std::array<Slot, Slots>, Levels> _levels{};
+  };
+}  // namespace exe
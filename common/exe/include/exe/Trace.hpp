@@ -0,0 +1,172 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <fmt/os.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+  namespace asio = boost::asio;
+}  // namespace
+
+namespace exe::trace
+{
+  // Span recorder for following a frame through the coroutines that handle it. Spans are written
+  // as complete events into a fixed size buffer owned by the thread that closes them, so recording
+  // is a couple of stores and never takes a lock. Buffers are dumped as Chrome trace-event JSON
+  // (chrome://tracing, ui.perfetto.dev). Tracing is off unless enable() is called.
+
+  struct Event
+  {
+    const char* name;
+    std::int64_t begin;
+    std::int64_t duration;
+    std::uint64_t coroutineId;
+    std::uint64_t frameId;
+  };
+
+  struct ThreadBuffer
+  {
+    static constexpr std::size_t Capacity = 1 << 16;
+
+    explicit ThreadBuffer(std::size_t tid) : tid{ tid }, events{ std::make_unique<Event[]>(Capacity) } { }
+
+    // Single producer (the owning thread), the exporter only reads up to `size`.
+    void push(const Event& event) noexcept
+    {
+      const auto n = size.load(std::memory_order_relaxed);
+      if (n == Capacity)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      events[n] = event;
+      size.store(n + 1, std::memory_order_release);
+    }
+
+    const std::size_t tid;
+    std::unique_ptr<Event[]> events;
+    std::atomic<std::size_t> size{ 0 };
+    std::atomic<std::size_t> dropped{ 0 };
+  };
+
+  namespace detail
+  {
+    inline std::atomic<bool> enabled{ false };
+    inline std::atomic<std::uint64_t> nextId{ 1 };
+    inline std::mutex registryMutex;
+    inline std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+    inline ThreadBuffer& threadBuffer()
+    {
+      thread_local std::shared_ptr<ThreadBuffer> buffer = []
+      {
+        std::lock_guard lock{ registryMutex };
+        return registry.emplace_back(std::make_shared<ThreadBuffer>(registry.size()));
+      }();
+
+      return *buffer;
+    }
+
+    // CLOCK_MONOTONIC is shared by all processes on the host, so client and server traces line up.
+    inline std::int64_t now() noexcept
+    {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+  }  // namespace detail
+
+  inline void enable() noexcept { detail::enabled.store(true, std::memory_order_relaxed); }
+  inline bool enabled() noexcept { return detail::enabled.load(std::memory_order_relaxed); }
+  inline std::uint64_t newId() noexcept { return detail::nextId.fetch_add(1, std::memory_order_relaxed); }
+
+  struct Span
+  {
+    Span(const char* name, std::uint64_t coroutineId, std::uint64_t frameId = 0) noexcept
+        : _name{ name }, _coroutineId{ coroutineId }, _frameId{ frameId }, _begin{ enabled() ? detail::now() : -1 }
+    {
+    }
+
+    Span(const Span&)            = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span() noexcept
+    {
+      if (_begin >= 0)
+      {
+        detail::threadBuffer().push({ _name, _begin, detail::now() - _begin, _coroutineId, _frameId });
+      }
+    }
+
+    // Frame IDs are often only known after the span started (e.g. once the request is parsed).
+    void frame(std::uint64_t frameId) noexcept { _frameId = frameId; }
+
+  private:
+    const char* _name;
+    std::uint64_t _coroutineId;
+    std::uint64_t _frameId;
+    std::int64_t _begin;
+  };
+
+  template<typename T>
+  asio::awaitable<T> traced(const char* name, asio::awaitable<T> awaitable)
+  {
+    Span span{ name, newId() };
+    co_return co_await std::move(awaitable);
+  }
+
+  // Only pays for the extra coroutine frame when tracing is enabled.
+  template<typename T>
+  asio::awaitable<T> maybeTraced(const char* name, asio::awaitable<T> awaitable)
+  {
+    if (!enabled())
+    {
+      return awaitable;
+    }
+
+    return traced(name, std::move(awaitable));
+  }
+
+  // Should be called once the traced threads are done, events still being recorded may be missed.
+  inline void exportChromeJson(const std::filesystem::path& path)
+  {
+    auto out = fmt::output_file(path.string());
+    out.print("{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    const auto pid = ::getpid();
+    bool first     = true;
+
+    std::lock_guard lock{ detail::registryMutex };
+    for (const auto& buffer : detail::registry)
+    {
+      const auto size = buffer->size.load(std::memory_order_acquire);
+      for (std::size_t i = 0; i < size; ++i)
+      {
+        const Event& e = buffer->events[i];
+        out.print("{}\n{{\"name\":\"{}\",\"cat\":\"camera_asio\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":{},\"tid\":{},"
+                  "\"args\":{{\"coro\":{},\"frame\":{}}}}}",
+                  first ? "" : ",", e.name, e.begin, e.duration, pid, buffer->tid, e.coroutineId, e.frameId);
+        first = false;
+      }
+
+      if (auto dropped = buffer->dropped.load(std::memory_order_relaxed))
+      {
+        out.print("{}\n{{\"name\":\"dropped {} events\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{},\"pid\":{},\"tid\":{}}}",
+                  first ? "" : ",", dropped, detail::now(), pid, buffer->tid);
+        first = false;
+      }
+    }
+
+    out.print("\n]}}\n");
+  }
+}  // namespace exe::trace
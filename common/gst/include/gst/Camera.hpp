@@ -3,12 +3,20 @@
 #include <fmt/core.h>
 #include <fmt/std.h>
 
+#include <algorithm>
+#include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <memory>
 #include <string_view>
+#include <vector>
 
 #include "Pipeline.hpp"
 #include "exe/Exe.hpp"
+#include "exe/Trace.hpp"
+#include "img/Jpeg.hpp"
 
 namespace
 {
@@ -26,20 +34,52 @@ namespace gst
     Error
   };
 
+  enum class CaptureMode
+  {
+    Single,
+    Burst,
+    Raw
+  };
+
+  struct BurstResult
+  {
+    PipelineMessage status = PipelineMessage::Idle;
+    std::vector<fs::path> frames;
+  };
+
   struct Camera
   {
-    Camera(const exe::Executor auto& executor, const fs::path &cameraDevice, const fs::path &path)
-        : _pipeline{ fmt::format(_config, cameraDevice.c_str(), path.c_str()) },
-          _streamDesc{ executor, _pipeline.getPollFd() }
+    Camera(const exe::Executor auto& executor,
+           const fs::path &cameraDevice,
+           const fs::path &path,
+           CaptureMode mode = CaptureMode::Single)
+        : _pipeline{ makeConfig(mode, cameraDevice, path) },
+          _streamDesc{ executor, _pipeline.getPollFd() },
+          _mode{ mode },
+          _traceId{ exe::trace::newId() }
     {
       if (!_pipeline)
       {
         throw std::runtime_error("Failed to create pipeline");
       }
+
+      if (_mode == CaptureMode::Burst)
+      {
+        installBurstGate();
+        // Keep the device opened and negotiated so that a burst only pays for PAUSED -> PLAYING.
+        _pipeline.pause();
+      }
     }
 
     asio::awaitable<PipelineMessage> take1()
     {
+      if (_mode == CaptureMode::Burst)
+      {
+        auto burst = co_await takeBurst(1, std::chrono::milliseconds{ 0 });
+        co_return burst.status;
+      }
+
+      exe::trace::Span span{ "capture", _traceId };
       PipelineMessage result = PipelineMessage::Idle;
       _pipeline.play();
 
@@ -55,16 +95,7 @@ namespace gst
           {
             if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
             {
-              GError *err;
-              char *debugInfo;
-              gst_message_parse_error(message, &err, &debugInfo);
-
-              spdlog::error("Error received from element {}: {}", GST_OBJECT_NAME(message->src), err->message);
-              spdlog::error("{}", debugInfo ? debugInfo : "none");
-
-              g_clear_error(&err);
-              g_free(debugInfo);
-
+              logError(message);
               result = PipelineMessage::Error;
             }
             else if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS)
@@ -91,14 +122,281 @@ namespace gst
       co_return result;
     }
 
+    // Captures `count` frames in one PLAYING run, at least `interval` apart (by buffer timestamp).
+    // Status is EoS once all frames are written, so callers can treat it like take1().
+    asio::awaitable<BurstResult> takeBurst(std::size_t count, std::chrono::milliseconds interval)
+    {
+      if (_mode != CaptureMode::Burst)
+      {
+        throw std::runtime_error("Camera is not created in burst mode");
+      }
+
+      BurstResult result;
+      result.frames.reserve(count);
+
+      if (count == 0)
+      {
+        result.status = PipelineMessage::EoS;
+        co_return result;
+      }
+
+      exe::trace::Span span{ "capture_burst", _traceId };
+      // GstClockTime is unsigned, a negative interval would never let a second frame through.
+      interval        = std::max(interval, std::chrono::milliseconds{ 0 });
+      _gate->interval = static_cast<GstClockTime>(std::chrono::nanoseconds{ interval }.count());
+      _gate->lastPts  = GST_CLOCK_TIME_NONE;
+      _gate->remaining.store(count);
+      _pipeline.play();
+
+      try
+      {
+        while (result.status == PipelineMessage::Idle)
+        {
+          co_await _streamDesc.async_wait(asio::posix::stream_descriptor::wait_read);
+
+          while (GstMessage *message = _pipeline.getMessage(_burstMessages))
+          {
+            if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+            {
+              logError(message);
+              result.status = PipelineMessage::Error;
+            }
+            else if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ELEMENT && gst_message_has_name(message, "GstMultiFileSink"))
+            {
+              const char *filename = gst_structure_get_string(gst_message_get_structure(message), "filename");
+              if (filename)
+              {
+                result.frames.emplace_back(filename);
+              }
+
+              if (result.frames.size() >= count)
+              {
+                result.status = PipelineMessage::EoS;
+              }
+            }
+            else if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS)
+            {
+              spdlog::critical("Unexpected end of stream in burst mode");
+              result.status = PipelineMessage::Error;
+            }
+
+            gst_message_unref(message);
+
+            if (result.status != PipelineMessage::Idle)
+            {
+              break;
+            }
+          }
+        }
+      }
+      catch (boost::system::system_error &se)
+      {
+        if (se.code() != boost::system::errc::operation_canceled)
+        {
+          _gate->remaining.store(0);
+          throw;
+        }
+      }
+
+      _gate->remaining.store(0);
+
+      if (result.status == PipelineMessage::Error)
+      {
+        // Restart from scratch on the next burst, the device may be in a bad state.
+        _pipeline.stop();
+      }
+      else
+      {
+        _pipeline.pause();
+      }
+
+      co_return result;
+    }
+
+    // Captures one unencoded RGB frame, for callers that encode it themselves (see img::encodeStreaming).
+    asio::awaitable<img::Image> takeRaw()
+    {
+      if (_mode != CaptureMode::Raw)
+      {
+        throw std::runtime_error("Camera is not created in raw mode");
+      }
+
+      exe::trace::Span span{ "capture_raw", _traceId };
+      _pipeline.play();
+
+      PipelineMessage status = PipelineMessage::Idle;
+      while (status == PipelineMessage::Idle)
+      {
+        co_await _streamDesc.async_wait(asio::posix::stream_descriptor::wait_read);
+
+        if (GstMessage *message = _pipeline.getMessage())
+        {
+          if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+          {
+            logError(message);
+            status = PipelineMessage::Error;
+          }
+          else
+          {
+            status = PipelineMessage::EoS;
+          }
+
+          gst_message_unref(message);
+        }
+      }
+
+      // The sample stays queued in the appsink after EOS until the pipeline is stopped.
+      GstSample *sample = nullptr;
+      if (status == PipelineMessage::EoS)
+      {
+        GstElement *sink = _pipeline.getElement("sink");
+        g_signal_emit_by_name(sink, "pull-sample", &sample);
+        gst_object_unref(sink);
+      }
+
+      _pipeline.stop();
+
+      if (!sample)
+      {
+        throw std::runtime_error("Pipeline error");
+      }
+
+      img::Image image = copyRgb(sample);
+      gst_sample_unref(sample);
+
+      co_return image;
+    }
+
     void cancel() { _streamDesc.cancel(); }
     ~Camera() noexcept { _pipeline.stop(); }
 
   private:
+    // Shared with the streaming thread through a pad probe in front of the encoder.
+    struct BurstGate
+    {
+      std::atomic<std::size_t> remaining{ 0 };
+      std::atomic<GstClockTime> interval{ 0 };
+      std::atomic<GstClockTime> lastPts{ GST_CLOCK_TIME_NONE };
+    };
+
+    static GstPadProbeReturn burstProbe(GstPad *, GstPadProbeInfo *info, gpointer userData)
+    {
+      auto *gate   = static_cast<BurstGate *>(userData);
+      GstBuffer *b = GST_PAD_PROBE_INFO_BUFFER(info);
+
+      if (gate->remaining.load() == 0)
+      {
+        return GST_PAD_PROBE_DROP;
+      }
+
+      const GstClockTime pts  = GST_BUFFER_PTS(b);
+      const GstClockTime last = gate->lastPts.load();
+      if (GST_CLOCK_TIME_IS_VALID(pts) && GST_CLOCK_TIME_IS_VALID(last) && pts - last < gate->interval.load())
+      {
+        return GST_PAD_PROBE_DROP;
+      }
+
+      gate->lastPts.store(pts);
+      gate->remaining.fetch_sub(1);
+      return GST_PAD_PROBE_OK;
+    }
+
+    void installBurstGate()
+    {
+      _gate = std::make_unique<BurstGate>();
+
+      GstElement *encoder = _pipeline.getElement("encoder");
+      if (!encoder)
+      {
+        throw std::runtime_error("Burst pipeline has no encoder");
+      }
+
+      GstPad *pad = gst_element_get_static_pad(encoder, "sink");
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, &Camera::burstProbe, _gate.get(), nullptr);
+
+      gst_object_unref(pad);
+      gst_object_unref(encoder);
+    }
+
+    // GStreamer pads every RGB row to a multiple of 4 bytes.
+    static img::Image copyRgb(GstSample *sample)
+    {
+      int width = 0, height = 0;
+      const GstStructure *caps = gst_caps_get_structure(gst_sample_get_caps(sample), 0);
+      if (!gst_structure_get_int(caps, "width", &width) || !gst_structure_get_int(caps, "height", &height))
+      {
+        throw std::runtime_error("Captured frame has no size");
+      }
+
+      img::Image image{ static_cast<unsigned>(width), static_cast<unsigned>(height), {} };
+      const auto row    = static_cast<std::size_t>(width) * 3;
+      const auto stride = GST_ROUND_UP_4(row);
+
+      GstMapInfo map;
+      GstBuffer *buffer = gst_sample_get_buffer(sample);
+      if (!gst_buffer_map(buffer, &map, GST_MAP_READ))
+      {
+        throw std::runtime_error("Failed to map the captured frame");
+      }
+
+      if (map.size < stride * static_cast<std::size_t>(image.height))
+      {
+        gst_buffer_unmap(buffer, &map);
+        throw std::runtime_error("Captured frame is smaller than its caps");
+      }
+
+      image.rgb.resize(row * static_cast<std::size_t>(image.height));
+      for (std::size_t y = 0; y < image.height; ++y)
+      {
+        std::memcpy(&image.rgb[y * row], map.data + y * stride, row);
+      }
+
+      gst_buffer_unmap(buffer, &map);
+      return image;
+    }
+
+    static std::string makeConfig(CaptureMode mode, const fs::path &cameraDevice, const fs::path &path)
+    {
+      if (mode == CaptureMode::Burst)
+      {
+        return fmt::format(_burstConfig, cameraDevice.c_str(), path.c_str());
+      }
+
+      if (mode == CaptureMode::Raw)
+      {
+        return fmt::format(_rawConfig, cameraDevice.c_str());
+      }
+
+      return fmt::format(_config, cameraDevice.c_str(), path.c_str());
+    }
+
+    static void logError(GstMessage *message)
+    {
+      GError *err;
+      char *debugInfo;
+      gst_message_parse_error(message, &err, &debugInfo);
+
+      LOG_ERROR_RATE_LIMITED(std::chrono::seconds{ 1 }, "Error received from element {}: {}", GST_OBJECT_NAME(message->src),
+                             err->message);
+      SPDLOG_DEBUG("{}", debugInfo ? debugInfo : "none");
+
+      g_clear_error(&err);
+      g_free(debugInfo);
+    }
+
     fs::path _path;
     Pipeline _pipeline;
     FileDesc _streamDesc;
+    CaptureMode _mode;
+    std::unique_ptr<BurstGate> _gate;
+    std::uint64_t _traceId;
     static constexpr const char *_config =
         "v4l2src device={} num-buffers=1 ! jpegenc !  multifilesink location={}/image\%d.jpg";
+    static constexpr const char *_burstConfig =
+        "v4l2src device={} ! jpegenc name=encoder ! multifilesink post-messages=true location={}/image\%d.jpg";
+    static constexpr const char *_rawConfig =
+        "v4l2src device={} num-buffers=1 ! videoconvert ! video/x-raw,format=RGB ! appsink name=sink sync=false";
+    static constexpr GstMessageType _burstMessages =
+        static_cast<GstMessageType>(GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_ELEMENT);
   };
-}  // namespace gst
\ No newline at end of file
+}  // namespace gst
@@ -25,11 +25,16 @@ namespace gst
 
         int getPollFd() const noexcept { return _pollFd.fd; }
         
-        GstMessage* getMessage() const noexcept
+        GstMessage* getMessage(GstMessageType types = static_cast<GstMessageType>(GST_MESSAGE_ERROR | GST_MESSAGE_EOS)) const noexcept
         {
-            return gst_bus_pop_filtered(_bus, static_cast<GstMessageType>(GST_MESSAGE_ERROR | GST_MESSAGE_EOS));
+            return gst_bus_pop_filtered(_bus, types);
         }
+
+        // Returns a new reference, caller has to unref it.
+        GstElement* getElement(const char* name) const noexcept { return gst_bin_get_by_name(GST_BIN(_pipeline), name); }
+
         void play() noexcept { gst_element_set_state(_pipeline, GST_STATE_PLAYING); }
+        void pause() noexcept { gst_element_set_state(_pipeline, GST_STATE_PAUSED); }
         void stop() noexcept { gst_element_set_state(_pipeline, GST_STATE_NULL); }
 
         explicit operator bool() const noexcept { return _pipeline; }
@@ -0,0 +1,228 @@
+#pragma once
+
+// jpeglib.h expects size_t and FILE to be declared.
+#include <cstddef>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+#include <csetjmp>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace img
+{
+  // Tightly packed 8-bit RGB pixels.
+  struct Image
+  {
+    unsigned width  = 0;
+    unsigned height = 0;
+    std::vector<unsigned char> rgb;
+  };
+
+  namespace detail
+  {
+    // libjpeg reports errors through a callback that must not return, jump back to the caller instead.
+    // Only C frames of libjpeg are skipped, the C++ objects of the caller are still alive after the jump.
+    struct ErrorManager
+    {
+      jpeg_error_mgr base;
+      std::jmp_buf jump;
+      char message[JMSG_LENGTH_MAX];
+    };
+
+    inline void onError(j_common_ptr info)
+    {
+      auto* errors = reinterpret_cast<ErrorManager*>(info->err);
+      (*info->err->format_message)(info, errors->message);
+      std::longjmp(errors->jump, 1);
+    }
+
+    inline void attach(ErrorManager& errors)
+    {
+      jpeg_std_error(&errors.base);
+      errors.base.error_exit = onError;
+    }
+  }  // namespace detail
+
+  // Decodes `jpeg` scaled down in the DCT domain by the largest factor (N/8) that still covers
+  // `minWidth` x `minHeight`, so only a fraction of the coefficients is ever transformed.
+  inline Image decodeScaled(std::string_view jpeg, unsigned minWidth, unsigned minHeight)
+  {
+    jpeg_decompress_struct info;
+    detail::ErrorManager errors;
+    Image image;
+
+    info.err = &errors.base;
+    detail::attach(errors);
+
+    if (setjmp(errors.jump))
+    {
+      jpeg_destroy_decompress(&info);
+      throw std::runtime_error(errors.message);
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, reinterpret_cast<const unsigned char*>(jpeg.data()), static_cast<unsigned long>(jpeg.size()));
+    jpeg_read_header(&info, TRUE);
+
+    info.out_color_space     = JCS_RGB;
+    info.dct_method          = JDCT_IFAST;
+    info.do_fancy_upsampling = FALSE;
+    info.scale_denom         = 8;
+    for (info.scale_num = 1; info.scale_num < 8; ++info.scale_num)
+    {
+      jpeg_calc_output_dimensions(&info);
+      if (info.output_width >= minWidth && info.output_height >= minHeight)
+      {
+        break;
+      }
+    }
+
+    jpeg_start_decompress(&info);
+
+    image.width  = info.output_width;
+    image.height = info.output_height;
+    image.rgb.resize(static_cast<std::size_t>(image.width) * image.height * 3);
+
+    const auto stride = static_cast<std::size_t>(image.width) * 3;
+    while (info.output_scanline < info.output_height)
+    {
+      JSAMPROW row = image.rgb.data() + info.output_scanline * stride;
+      jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    return image;
+  }
+
+  inline std::string encode(const Image& image, int quality = 80)
+  {
+    jpeg_compress_struct info;
+    detail::ErrorManager errors;
+    unsigned char* buffer = nullptr;
+    unsigned long size    = 0;
+
+    info.err = &errors.base;
+    detail::attach(errors);
+
+    if (setjmp(errors.jump))
+    {
+      jpeg_destroy_compress(&info);
+      std::free(buffer);
+      throw std::runtime_error(errors.message);
+    }
+
+    jpeg_create_compress(&info);
+    jpeg_mem_dest(&info, &buffer, &size);
+
+    info.image_width      = image.width;
+    info.image_height     = image.height;
+    info.input_components = 3;
+    info.in_color_space   = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    info.dct_method = JDCT_IFAST;
+
+    jpeg_start_compress(&info, TRUE);
+
+    const auto stride = static_cast<std::size_t>(image.width) * 3;
+    while (info.next_scanline < info.image_height)
+    {
+      auto* row = const_cast<JSAMPROW>(image.rgb.data() + info.next_scanline * stride);
+      jpeg_write_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    std::string encoded{ reinterpret_cast<const char*>(buffer), size };
+    std::free(buffer);
+    return encoded;
+  }
+
+  // Encodes `image` and hands the output to `sink` in blocks of `chunkSize` bytes while encoding is
+  // still in progress, so the first bytes can be sent before the last rows are compressed.
+  inline void encodeStreaming(const Image& image,
+                              const std::function<void(std::string_view)>& sink,
+                              std::size_t chunkSize = 64 * 1024,
+                              int quality           = 80)
+  {
+    struct Destination
+    {
+      jpeg_destination_mgr base;
+      const std::function<void(std::string_view)>* sink;
+      std::vector<unsigned char> buffer;
+
+      static void init(j_compress_ptr info)
+      {
+        auto* dest                  = reinterpret_cast<Destination*>(info->dest);
+        dest->base.next_output_byte = dest->buffer.data();
+        dest->base.free_in_buffer   = dest->buffer.size();
+      }
+
+      static boolean flush(j_compress_ptr info)
+      {
+        auto* dest = reinterpret_cast<Destination*>(info->dest);
+        (*dest->sink)({ reinterpret_cast<const char*>(dest->buffer.data()), dest->buffer.size() });
+        init(info);
+        return TRUE;
+      }
+
+      static void term(j_compress_ptr info)
+      {
+        auto* dest       = reinterpret_cast<Destination*>(info->dest);
+        const auto count = dest->buffer.size() - dest->base.free_in_buffer;
+        if (count > 0)
+        {
+          (*dest->sink)({ reinterpret_cast<const char*>(dest->buffer.data()), count });
+        }
+      }
+    };
+
+    jpeg_compress_struct info;
+    detail::ErrorManager errors;
+    Destination destination{ {}, &sink, std::vector<unsigned char>(chunkSize) };
+
+    info.err = &errors.base;
+    detail::attach(errors);
+
+    if (setjmp(errors.jump))
+    {
+      jpeg_destroy_compress(&info);
+      throw std::runtime_error(errors.message);
+    }
+
+    jpeg_create_compress(&info);
+    destination.base.init_destination    = &Destination::init;
+    destination.base.empty_output_buffer = &Destination::flush;
+    destination.base.term_destination    = &Destination::term;
+    info.dest                            = &destination.base;
+
+    info.image_width      = image.width;
+    info.image_height     = image.height;
+    info.input_components = 3;
+    info.in_color_space   = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    info.dct_method = JDCT_IFAST;
+
+    jpeg_start_compress(&info, TRUE);
+
+    const auto stride = static_cast<std::size_t>(image.width) * 3;
+    while (info.next_scanline < info.image_height)
+    {
+      auto* row = const_cast<JSAMPROW>(image.rgb.data() + info.next_scanline * stride);
+      jpeg_write_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+  }
+}  // namespace img
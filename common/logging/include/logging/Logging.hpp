@@ -0,0 +1,98 @@
+#pragma once
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace logging
+{
+  // Replaces the default logger with an asynchronous one. Log calls only format the message and
+  // push it into a ring buffer, sinks run on a single background thread. When the queue is full
+  // the oldest entries are overwritten, so a slow terminal or disk never blocks the caller.
+  inline void init(const std::filesystem::path& logFile = {}, std::size_t queueSize = 8192)
+  {
+    spdlog::init_thread_pool(queueSize, 1);
+
+    std::shared_ptr<spdlog::sinks::sink> sink;
+    if (logFile.empty())
+    {
+      sink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    }
+    else
+    {
+      sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(logFile.string());
+    }
+
+    auto logger = std::make_shared<spdlog::async_logger>("camera_asio", std::move(sink), spdlog::thread_pool(),
+                                                         spdlog::async_overflow_policy::overrun_oldest);
+    logger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    logger->flush_on(spdlog::level::err);
+
+    spdlog::set_default_logger(std::move(logger));
+  }
+
+  // Drains the queue and joins the background thread.
+  inline void shutdown() { spdlog::shutdown(); }
+
+  // Lets at most one message through per interval and counts the rest.
+  struct RateLimiter
+  {
+    using Clock = std::chrono::steady_clock;
+
+    explicit RateLimiter(Clock::duration interval) : _interval{ interval.count() } { }
+
+    // Returns true if the message may be logged, `suppressed` is then set to the number of
+    // messages dropped since the previous one.
+    bool allow(std::uint64_t& suppressed) noexcept
+    {
+      const auto now = Clock::now().time_since_epoch().count();
+      auto last      = _last.load(std::memory_order_relaxed);
+
+      if ((last != 0 && now - last < _interval) || !_last.compare_exchange_strong(last, now, std::memory_order_relaxed))
+      {
+        _suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+      return true;
+    }
+
+  private:
+    Clock::rep _interval;
+    std::atomic<Clock::rep> _last{ 0 };
+    std::atomic<std::uint64_t> _suppressed{ 0 };
+  };
+}  // namespace logging
+
+// Rate limited logging, every call site gets its own limiter. Levels below SPDLOG_ACTIVE_LEVEL
+// are compiled out the same way as the SPDLOG_* macros.
+#define LOG_RATE_LIMITED(logLevel, interval, ...)                                                           \
+  do                                                                                                        \
+  {                                                                                                         \
+    if constexpr (logLevel >= SPDLOG_ACTIVE_LEVEL)                                                          \
+    {                                                                                                       \
+      static ::logging::RateLimiter logLimiter_{ interval };                                                \
+      std::uint64_t logSuppressed_ = 0;                                                                     \
+      if (logLimiter_.allow(logSuppressed_))                                                                \
+      {                                                                                                     \
+        if (logSuppressed_ > 0)                                                                             \
+        {                                                                                                   \
+          spdlog::default_logger_raw()->log(static_cast<spdlog::level::level_enum>(logLevel),               \
+                                            "{} similar messages suppressed", logSuppressed_);              \
+        }                                                                                                   \
+        spdlog::default_logger_raw()->log(static_cast<spdlog::level::level_enum>(logLevel), __VA_ARGS__);  \
+      }                                                                                                     \
+    }                                                                                                       \
+  } while (false)
+
+#define LOG_ERROR_RATE_LIMITED(interval, ...)    LOG_RATE_LIMITED(SPDLOG_LEVEL_ERROR, interval, __VA_ARGS__)
+#define LOG_WARN_RATE_LIMITED(interval, ...)     LOG_RATE_LIMITED(SPDLOG_LEVEL_WARN, interval, __VA_ARGS__)
+#define LOG_CRITICAL_RATE_LIMITED(interval, ...) LOG_RATE_LIMITED(SPDLOG_LEVEL_CRITICAL, interval, __VA_ARGS__)
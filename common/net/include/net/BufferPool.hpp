@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace net
+{
+  // Free list of per-connection objects, so that new connections reuse the capacity grown by the
+  // previous ones instead of allocating it again. Not thread-safe, it has to be used from the
+  // executor that owns it and has to outlive all of its leases.
+  template<typename T>
+  struct BufferPool
+  {
+    struct Release
+    {
+      BufferPool* pool;
+      void operator()(T* item) const noexcept { pool->release(item); }
+    };
+
+    using Lease = std::unique_ptr<T, Release>;
+
+    explicit BufferPool(std::size_t maxIdle = 64) : _maxIdle{ maxIdle } { _idle.reserve(_maxIdle); }
+
+    BufferPool(const BufferPool&)            = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    Lease acquire()
+    {
+      if (_idle.empty())
+      {
+        return Lease{ new T{}, Release{ this } };
+      }
+
+      auto item = std::move(_idle.back());
+      _idle.pop_back();
+      return Lease{ item.release(), Release{ this } };
+    }
+
+  private:
+    void release(T* item) noexcept
+    {
+      std::unique_ptr<T> owned{ item };
+      if (_idle.size() < _maxIdle)
+      {
+        _idle.push_back(std::move(owned));
+      }
+    }
+
+    std::size_t _maxIdle;
+    std::vector<std::unique_ptr<T>> _idle;
+  };
+}  // namespace net
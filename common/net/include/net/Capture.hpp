@@ -0,0 +1,183 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/endian/buffers.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/Framing.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+}  // namespace
+
+namespace net::capture
+{
+  // Compact record of the frames a server received, for replaying its traffic offline:
+  //
+  //   FileHeader, then per frame a RecordHeader followed by `length` bytes of the frame if the
+  //   capture has bodies (FlagBodies), back to back
+  //
+  // Offsets are taken from a monotonic clock, so records are in arrival order.
+
+  inline constexpr std::uint32_t Magic      = 0x43415054;  // "CAPT"
+  inline constexpr std::uint32_t Version    = 1;
+  inline constexpr std::uint32_t FlagBodies = 1;
+
+  struct FileHeader
+  {
+    boost::endian::big_uint32_buf_t magic;
+    boost::endian::big_uint32_buf_t version;
+    boost::endian::big_uint32_buf_t flags;
+    boost::endian::big_uint64_buf_t start;  // Microseconds since the UNIX epoch
+  };
+
+  struct RecordHeader
+  {
+    boost::endian::big_uint64_buf_t offset;  // Microseconds since `start`
+    boost::endian::big_uint32_buf_t sourceId;
+    boost::endian::big_uint32_buf_t length;
+  };
+
+  static_assert(sizeof(FileHeader) == 20);
+  static_assert(sizeof(RecordHeader) == 16);
+
+  // Appends a record per received frame. Thread-safe, shared by the endpoints of all threads: a network thread only
+  // takes the offset and a copy of the frame, the file is written on a thread of its own.
+  struct Writer
+  {
+    Writer(const fs::path& path, bool bodies) : _bodies{ bodies }, _start{ std::chrono::steady_clock::now() }
+    {
+      _file.rdbuf()->pubsetbuf(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+      _file.open(path, std::ios::binary | std::ios::trunc);
+      if (!_file.is_open())
+      {
+        throw std::runtime_error("Can't open capture file");
+      }
+
+      FileHeader header;
+      header.magic   = Magic;
+      header.version = Version;
+      header.flags   = bodies ? FlagBodies : 0;
+      header.start   = framing::timestampNow();
+      _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // Writes the records still queued.
+    ~Writer() { _pool.join(); }
+
+    void record(std::string_view data, std::uint32_t sourceId)
+    {
+      RecordHeader record;
+      record.sourceId = sourceId;
+      record.length   = static_cast<std::uint32_t>(data.size());
+
+      std::string body{ _bodies ? data : std::string_view{} };
+
+      // Offsets are taken and queued in one go, so the records stay in arrival order.
+      std::lock_guard lock{ _mutex };
+      record.offset = static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count());
+
+      asio::post(_strand,
+                 [this, record, body = std::move(body)]
+                 {
+                   _file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+                   _file.write(body.data(), static_cast<std::streamsize>(body.size()));
+                 });
+    }
+
+  private:
+    std::vector<char> _buffer = std::vector<char>(1 << 20);
+    std::ofstream _file;
+    bool _bodies;
+    std::chrono::steady_clock::time_point _start;
+    std::mutex _mutex;
+    asio::thread_pool _pool{ 1 };
+    asio::strand<asio::thread_pool::executor_type> _strand{ _pool.get_executor() };
+  };
+
+  struct Record
+  {
+    std::uint64_t offset;
+    std::uint32_t sourceId;
+    std::uint32_t length;
+    std::streamoff body;  // Position of the frame in the file, if the capture has bodies
+  };
+
+  // Reads the records of a capture up front and the bodies on demand.
+  struct Reader
+  {
+    explicit Reader(const fs::path& path) : _file{ path, std::ios::binary }
+    {
+      FileHeader header;
+      if (!_file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic.value() != Magic)
+      {
+        throw std::runtime_error("Not a capture file");
+      }
+
+      if (header.version.value() != Version)
+      {
+        throw std::runtime_error("Unsupported capture version");
+      }
+
+      _bodies = (header.flags.value() & FlagBodies) != 0;
+      _start  = header.start.value();
+
+      RecordHeader record;
+      while (_file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+      {
+        _records.push_back({ record.offset.value(), record.sourceId.value(), record.length.value(), _file.tellg() });
+        if (_bodies)
+        {
+          _file.seekg(record.length.value(), std::ios::cur);
+        }
+      }
+
+      // A capture cut short by a crash ends with a partial record.
+      if (_bodies && !_records.empty())
+      {
+        _file.clear();
+        _file.seekg(0, std::ios::end);
+        if (_records.back().body + _records.back().length > _file.tellg())
+        {
+          _records.pop_back();
+        }
+      }
+
+      _file.clear();
+    }
+
+    bool hasBodies() const noexcept { return _bodies; }
+    std::uint64_t start() const noexcept { return _start; }
+    const std::vector<Record>& records() const noexcept { return _records; }
+
+    std::string body(const Record& record)
+    {
+      if (!_bodies)
+      {
+        throw std::runtime_error("Capture has no bodies");
+      }
+
+      std::string data(record.length, '\0');
+      _file.seekg(record.body);
+      _file.read(data.data(), static_cast<std::streamsize>(data.size()));
+      return data;
+    }
+
+  private:
+    std::ifstream _file;
+    bool _bodies = false;
+    std::uint64_t _start = 0;
+    std::vector<Record> _records;
+  };
+}  // namespace net::capture
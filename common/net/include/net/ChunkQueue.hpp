@@ -0,0 +1,96 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "exe/Exe.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+}  // namespace
+
+namespace net
+{
+  // Hands the chunks of one body from a producer thread (e.g. an encoder) to a coroutine that sends
+  // them. push() and close() may be called from any thread, pop() only from `executor`. Has to be
+  // owned by a shared_ptr, both sides may outlive each other.
+  struct ChunkQueue : std::enable_shared_from_this<ChunkQueue>
+  {
+    explicit ChunkQueue(const exe::Executor auto& executor)
+        : _signal{ executor, asio::steady_timer::time_point::max() }
+    {
+    }
+
+    void push(std::string chunk)
+    {
+      {
+        std::lock_guard lock{ _mutex };
+        _chunks.push_back(std::move(chunk));
+      }
+
+      wake();
+    }
+
+    // Ends the body, with `error` rethrown by pop() once the queued chunks are consumed.
+    void close(std::exception_ptr error = nullptr)
+    {
+      {
+        std::lock_guard lock{ _mutex };
+        _closed = true;
+        _error  = std::move(error);
+      }
+
+      wake();
+    }
+
+    // Returns the next chunk, or nothing once the queue is closed and drained.
+    asio::awaitable<std::optional<std::string>> pop()
+    {
+      while (true)
+      {
+        {
+          std::lock_guard lock{ _mutex };
+          if (!_chunks.empty())
+          {
+            auto chunk = std::move(_chunks.front());
+            _chunks.pop_front();
+            co_return chunk;
+          }
+
+          if (_closed)
+          {
+            if (_error)
+            {
+              std::rethrow_exception(_error);
+            }
+
+            co_return std::nullopt;
+          }
+        }
+
+        // Woken by cancellation, see wake().
+        co_await _signal.async_wait();
+      }
+    }
+
+  private:
+    // The cancellation is posted to the consumer's executor, so it can't slip in between pop()
+    // checking the queue and starting to wait.
+    void wake()
+    {
+      asio::post(_signal.get_executor(), [self = shared_from_this()] { self->_signal.cancel(); });
+    }
+
+    Timer _signal;
+    std::mutex _mutex;
+    std::deque<std::string> _chunks;
+    bool _closed = false;
+    std::exception_ptr _error;
+  };
+}  // namespace net
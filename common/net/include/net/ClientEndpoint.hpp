@@ -6,11 +6,19 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <algorithm>
+#include <charconv>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 #include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "net/ChunkQueue.hpp"
 
 namespace
 {
@@ -26,30 +34,94 @@ namespace
 
 namespace net
 {
+  // The server refused a frame (4xx), sending it again would get the same answer.
+  struct UploadRejected : std::runtime_error
+  {
+    using std::runtime_error::runtime_error;
+  };
 
   struct ClientEndpoint
   {
     ClientEndpoint(const exe::Executor auto& executor, std::string host, std::string port, std::int64_t timeout)
-        : _resolver{ executor }, _stream{ executor }, _host{ std::move(host) }, _port{ std::move(port) }, _timeout{ timeout }
+        : _resolver{ executor },
+          _stream{ executor },
+          _wheel{ executor },
+          _deadline{ [this]
+                     {
+                       boost::system::error_code ec;
+                       _stream.socket().cancel(ec);
+                     } },
+          _host{ std::move(host) },
+          _port{ std::move(port) },
+          _timeout{ timeout },
+          _traceId{ exe::trace::newId() }
     {
     }
 
     asio::awaitable<void> sendFile(fs::path imagePath)
     {
+      const auto frameId = exe::trace::newId();
+      co_await upload(prepareRequest(imagePath, frameId), frameId);
+    }
+
+    // Uploads a frame that is already in memory, e.g. one replayed from a capture.
+    asio::awaitable<void> sendData(std::string data, std::uint32_t sourceId = 0)
+    {
+      const auto frameId = exe::trace::newId();
+
+      http::request<http::string_body> req;
+      prepareHeader(req, frameId);
+      req.set("X-Source-Id", std::to_string(sourceId));
+      req.body() = std::move(data);
+      req.prepare_payload();
+
+      co_await upload(std::move(req), frameId);
+    }
+
+    // Uploads a body of unknown length with chunked transfer-encoding. Chunks are written as soon as
+    // the producer pushes them, so the upload overlaps with producing (e.g. encoding) the frame.
+    asio::awaitable<void> sendChunked(std::shared_ptr<ChunkQueue> chunks)
+    {
+      const auto frameId = exe::trace::newId();
+      exe::trace::Span upload{ "upload_chunked", _traceId, frameId };
+
       try
       {
-        auto const results = co_await _resolver.async_resolve(_host, _port);
-        _stream.expires_after(_timeout);
-        co_await _stream.async_connect(results);
+        co_await connect(frameId);
 
-        _stream.expires_after(_timeout);
-        auto req = prepareRequest(imagePath);
-        co_await http::async_write(_stream, req);
+        http::request<http::empty_body> req;
+        prepareHeader(req, frameId);
+        req.chunked(true);
+
+        {
+          exe::trace::Span span{ "write_header", _traceId, frameId };
+          _wheel.arm(_deadline, _timeout);
+          http::request_serializer<http::empty_body> serializer{ req };
+          co_await http::async_write_header(_stream, serializer);
+        }
+
+        while (auto chunk = co_await chunks->pop())
+        {
+          exe::trace::Span span{ "write_chunk", _traceId, frameId };
+          _wheel.arm(_deadline, _timeout);
+          co_await asio::async_write(_stream, http::make_chunk(asio::buffer(*chunk)));
+        }
+
+        {
+          exe::trace::Span span{ "write_chunk", _traceId, frameId };
+          _wheel.arm(_deadline, _timeout);
+          co_await asio::async_write(_stream, http::make_chunk_last());
+        }
 
         beast::flat_buffer resBuffer;
         http::response<http::dynamic_body> res;
 
-        co_await http::async_read(_stream, resBuffer, res);
+        {
+          exe::trace::Span span{ "read_response", _traceId, frameId };
+          co_await http::async_read(_stream, resBuffer, res);
+        }
+
+        _wheel.disarm(_deadline);
 
         std::cout << res << std::endl;
 
@@ -57,6 +129,13 @@ namespace net
       }
       catch (boost::system::system_error& se)
       {
+        const bool timedOut = _deadline.expired();
+        _wheel.disarm(_deadline);
+        _stream.close();
+
+        if (timedOut)
+          throw boost::system::system_error{ beast::error::timeout };
+
         if (se.code() != boost::system::errc::operation_canceled)
           throw;
       }
@@ -64,24 +143,244 @@ namespace net
       co_return;
     }
 
-  private:
-    http::request<http::file_body> prepareRequest(const fs::path& imagePath)
+    // Uploads a spooled frame under a stable `uploadId`, see ServerEndpoint::resumeWith. With `resume` (the frame
+    // was attempted before) the server is asked how much of it arrived and only the rest is sent. The connection is
+    // kept alive between calls, so a backlog drains without a handshake per frame. Returns the bytes sent.
+    asio::awaitable<std::uint64_t> sendResumable(std::string uploadId,
+                                                 fs::path imagePath,
+                                                 std::uint32_t sourceId,
+                                                 bool resume)
     {
-      boost::beast::error_code ec;
-      http::file_body::value_type body;
-      body.open(imagePath.c_str(), boost::beast::file_mode::read, ec);
+      const auto frameId = exe::trace::newId();
+      exe::trace::Span upload{ "upload_resumable", _traceId, frameId };
 
-      if (ec == beast::errc::no_such_file_or_directory)
+      std::error_code ec;
+      const auto length = fs::file_size(imagePath, ec);
+      if (ec)
         throw std::runtime_error("Can't open image file");
 
-      http::request<http::file_body> req;
+      try
+      {
+        if (!_stream.socket().is_open())
+        {
+          co_await connect(frameId);
+        }
+
+        std::uint64_t offset = 0;
+        if (resume)
+        {
+          http::request<http::empty_body> req;
+          prepareHeader(req, frameId);
+          req.method(http::verb::head);
+          req.set("X-Upload-Id", uploadId);
+
+          const auto [status, held] = co_await exchange(req, frameId);
+          if (status != http::status::ok)
+            fail(status, "Upload offset query failed");
+
+          offset = held;
+        }
+
+        // A conflict tells where the server stands, the second attempt continues from there.
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+          offset = std::min(offset, length);
+
+          http::request<http::string_body> req;
+          prepareHeader(req, frameId);
+          req.set("X-Source-Id", std::to_string(sourceId));
+          req.set("X-Upload-Id", uploadId);
+          req.set("X-Upload-Offset", std::to_string(offset));
+          req.set("X-Upload-Length", std::to_string(length));
+          req.body() = readFile(imagePath, offset, length);
+          req.prepare_payload();
+
+          const auto [status, held] = co_await exchange(req, frameId);
+          if (status == http::status::ok && held == length)
+          {
+            std::cout << "Uploaded " << uploadId << " (" << length - offset << " of " << length << " bytes)" << std::endl;
+            co_return length - offset;
+          }
+
+          if (status != http::status::conflict)
+            fail(status, "Upload failed");
+
+          offset = held;
+        }
+
+        throw std::runtime_error("Upload out of sync with the server");
+      }
+      catch (boost::system::system_error& se)
+      {
+        const bool timedOut = _deadline.expired();
+        _wheel.disarm(_deadline);
+        disconnect();
+
+        if (timedOut)
+          throw boost::system::system_error{ beast::error::timeout };
+
+        throw;
+      }
+      catch (const std::runtime_error&)
+      {
+        _wheel.disarm(_deadline);
+        disconnect();
+        throw;
+      }
+    }
+
+    // Closes the connection kept alive by sendResumable, e.g. before it would sit idle.
+    void disconnect()
+    {
+      _stream.close();
+      _buffer.clear();
+    }
+
+  private:
+    // Client errors are final, anything else may pass on a retry.
+    [[noreturn]] static void fail(http::status status, std::string_view what)
+    {
+      const auto message = fmt::format("{} with {}", what, static_cast<unsigned>(status));
+      if (http::to_status_class(status) == http::status_class::client_error)
+        throw UploadRejected(message);
+
+      throw std::runtime_error(message);
+    }
+
+    asio::awaitable<void> connect(std::uint64_t frameId)
+    {
+      tcp::resolver::results_type results;
+      {
+        exe::trace::Span span{ "resolve", _traceId, frameId };
+        results = co_await _resolver.async_resolve(_host, _port);
+      }
+
+      {
+        exe::trace::Span span{ "connect", _traceId, frameId };
+        _wheel.arm(_deadline, _timeout);
+        co_await _stream.async_connect(results);
+      }
+    }
 
+    // Writes a request on the kept-alive connection, returns the response status and X-Upload-Offset.
+    template<class Body>
+    asio::awaitable<std::pair<http::status, std::uint64_t>> exchange(http::request<Body>& req, std::uint64_t frameId)
+    {
+      req.keep_alive(true);
+
+      _wheel.arm(_deadline, _timeout);
+      {
+        exe::trace::Span span{ "write_request", _traceId, frameId };
+        co_await http::async_write(_stream, req);
+      }
+
+      http::response_parser<http::string_body> parser;
+      parser.skip(req.method() == http::verb::head);
+      {
+        exe::trace::Span span{ "read_response", _traceId, frameId };
+        co_await http::async_read(_stream, _buffer, parser);
+      }
+
+      _wheel.disarm(_deadline);
+
+      const auto& res = parser.get();
+      if (!res.keep_alive())
+      {
+        disconnect();
+      }
+
+      std::uint64_t offset = 0;
+      auto value           = res["X-Upload-Offset"];
+      std::from_chars(value.data(), value.data() + value.size(), offset);
+      co_return std::pair{ res.result(), offset };
+    }
+
+    // One request per connection.
+    template<class Body>
+    asio::awaitable<void> upload(http::request<Body> req, std::uint64_t frameId)
+    {
+      exe::trace::Span request{ "upload", _traceId, frameId };
+
+      try
+      {
+        co_await connect(frameId);
+
+        _wheel.arm(_deadline, _timeout);
+        {
+          exe::trace::Span span{ "write_request", _traceId, frameId };
+          co_await http::async_write(_stream, req);
+        }
+
+        beast::flat_buffer resBuffer;
+        http::response<http::dynamic_body> res;
+
+        {
+          exe::trace::Span span{ "read_response", _traceId, frameId };
+          co_await http::async_read(_stream, resBuffer, res);
+        }
+
+        _wheel.disarm(_deadline);
+
+        std::cout << res << std::endl;
+
+        _stream.socket().shutdown(tcp::socket::shutdown_both);
+      }
+      catch (boost::system::system_error& se)
+      {
+        const bool timedOut = _deadline.expired();
+        _wheel.disarm(_deadline);
+
+        if (timedOut)
+          throw boost::system::system_error{ beast::error::timeout };
+
+        if (se.code() != boost::system::errc::operation_canceled)
+          throw;
+      }
+
+      co_return;
+    }
+
+    template<class Body>
+    void prepareHeader(http::request<Body>& req, std::uint64_t frameId) const
+    {
       req.method(http::verb::post);
       req.target("/screenshot");
       req.version(11);
       req.set(http::field::host, _host);
       req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
       req.set(http::field::content_type, "image/jpeg");
+      req.set("X-Frame-Id", std::to_string(frameId));
+    }
+
+    static std::string readFile(const fs::path& imagePath, std::uint64_t offset, std::uint64_t length)
+    {
+      std::ifstream file{ imagePath, std::ios::binary };
+      if (!file.is_open())
+      {
+        throw std::runtime_error("Can't open image file");
+      }
+
+      std::string data(static_cast<std::size_t>(length - offset), '\0');
+      file.seekg(static_cast<std::streamoff>(offset));
+      if (!file.read(data.data(), static_cast<std::streamsize>(data.size())))
+      {
+        throw std::runtime_error("Image file changed while uploading");
+      }
+
+      return data;
+    }
+
+    http::request<http::file_body> prepareRequest(const fs::path& imagePath, std::uint64_t frameId)
+    {
+      boost::beast::error_code ec;
+      http::file_body::value_type body;
+      body.open(imagePath.c_str(), boost::beast::file_mode::read, ec);
+
+      if (ec == beast::errc::no_such_file_or_directory)
+        throw std::runtime_error("Can't open image file");
+
+      http::request<http::file_body> req;
+      prepareHeader(req, frameId);
       req.body() = std::move(body);
       req.prepare_payload();
 
@@ -90,8 +389,12 @@ namespace net
 
     Resolver _resolver;
     TcpStream _stream;
+    beast::flat_buffer _buffer;
+    exe::TimerWheel _wheel;
+    exe::TimerWheel::Entry _deadline;
     std::string _host;
     std::string _port;
     std::chrono::seconds _timeout;
+    std::uint64_t _traceId;
   };
 }  // namespace net
\ No newline at end of file
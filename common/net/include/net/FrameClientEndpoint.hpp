@@ -0,0 +1,204 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "net/Framing.hpp"
+
+namespace
+{
+  namespace asio  = boost::asio;
+  namespace beast = boost::beast;
+  namespace fs    = std::filesystem;
+  using tcp       = asio::ip::tcp;
+  using local     = asio::local::stream_protocol;
+  using Resolver  = asio::use_awaitable_t<>::as_default_on_t<tcp::resolver>;
+}  // namespace
+
+namespace net
+{
+  // Client side of the binary framing protocol (see Framing.hpp), over TCP or a Unix domain socket.
+  // Keeps one connection open and pipelines up to `window` unacknowledged frames on it.
+  template<typename Protocol>
+  struct BasicFrameClientEndpoint
+  {
+    using Socket = typename asio::use_awaitable_t<>::template as_default_on_t<typename Protocol::socket>;
+
+    // TCP: `host` and `port` are resolved on every connect.
+    // Unix domain socket: `host` is the socket path and `port` is ignored.
+    BasicFrameClientEndpoint(const exe::Executor auto& executor,
+                             std::string host,
+                             std::string port,
+                             std::int64_t timeout,
+                             std::uint32_t sourceId,
+                             std::size_t window = 64)
+        : _socket{ executor },
+          _wheel{ executor },
+          _deadline{ [this]
+                     {
+                       boost::system::error_code ec;
+                       _socket.cancel(ec);
+                     } },
+          _host{ std::move(host) },
+          _port{ std::move(port) },
+          _timeout{ timeout },
+          _sourceId{ sourceId },
+          _window{ window },
+          _traceId{ exe::trace::newId() }
+    {
+    }
+
+    asio::awaitable<void> sendFile(fs::path imagePath)
+    {
+      readFile(imagePath);
+      co_await send({ _payload.data(), _payload.size() }, _sourceId);
+    }
+
+    // Sends a frame that is already in memory under its own source ID, e.g. one replayed from a capture.
+    asio::awaitable<void> send(std::string_view data, std::uint32_t sourceId)
+    {
+      try
+      {
+        if (!_socket.is_open())
+        {
+          co_await connect();
+        }
+
+        framing::FrameHeader header;
+        header.magic     = framing::FrameMagic;
+        header.sourceId  = sourceId;
+        header.length    = static_cast<std::uint32_t>(data.size());
+        header.sequence  = ++_sequence;
+        header.timestamp = framing::timestampNow();
+
+        {
+          exe::trace::Span span{ "write_frame", _traceId, _sequence };
+          _wheel.arm(_deadline, _timeout);
+          std::array<asio::const_buffer, 2> buffers{ asio::buffer(&header, sizeof(header)), asio::buffer(data) };
+          co_await asio::async_write(_socket, buffers);
+        }
+
+        while (_sequence - _acked >= _window)
+        {
+          exe::trace::Span span{ "wait_ack", _traceId, _sequence };
+          co_await readAcks();
+        }
+
+        _wheel.disarm(_deadline);
+      }
+      catch (boost::system::system_error& se)
+      {
+        const bool timedOut = _deadline.expired();
+        _wheel.disarm(_deadline);
+        close();
+
+        if (timedOut)
+          throw boost::system::system_error{ beast::error::timeout };
+
+        if (se.code() != boost::system::errc::operation_canceled)
+          throw;
+      }
+
+      co_return;
+    }
+
+    std::uint64_t acknowledged() const noexcept { return _acked; }
+
+  private:
+    asio::awaitable<void> connect()
+    {
+      if constexpr (std::is_same_v<Protocol, tcp>)
+      {
+        Resolver resolver{ _socket.get_executor() };
+        auto const results = co_await resolver.async_resolve(_host, _port);
+
+        _wheel.arm(_deadline, _timeout);
+        co_await asio::async_connect(_socket, results);
+        _socket.set_option(tcp::no_delay{ true });
+      }
+      else
+      {
+        _wheel.arm(_deadline, _timeout);
+        co_await _socket.async_connect(typename Protocol::endpoint{ _host });
+      }
+
+      // Sequence numbers are per connection.
+      _sequence = 0;
+      _acked    = 0;
+      _acks.clear();
+    }
+
+    asio::awaitable<void> readAcks()
+    {
+      _wheel.arm(_deadline, _timeout);
+      auto transferred = co_await _socket.async_read_some(_acks.prepare(256));
+      _acks.commit(transferred);
+
+      while (_acks.size() >= sizeof(framing::AckHeader))
+      {
+        framing::AckHeader ack;
+        std::memcpy(&ack, _acks.data().data(), sizeof(ack));
+        _acks.consume(sizeof(ack));
+
+        if (ack.magic.value() != framing::AckMagic)
+        {
+          throw boost::system::system_error{ asio::error::invalid_argument };
+        }
+
+        _acked = std::max(_acked, ack.sequence.value());
+      }
+    }
+
+    void readFile(const fs::path& imagePath)
+    {
+      std::ifstream file{ imagePath, std::ios::binary | std::ios::ate };
+      if (!file.is_open())
+      {
+        throw std::runtime_error("Can't open image file");
+      }
+
+      _payload.resize(static_cast<std::size_t>(file.tellg()));
+      file.seekg(0);
+      file.read(_payload.data(), static_cast<std::streamsize>(_payload.size()));
+    }
+
+    void close()
+    {
+      boost::system::error_code ec;
+      _socket.close(ec);
+
+      if (_sequence > _acked)
+      {
+        spdlog::warn("Connection closed with {} unacknowledged frames", _sequence - _acked);
+      }
+    }
+
+    Socket _socket;
+    exe::TimerWheel _wheel;
+    exe::TimerWheel::Entry _deadline;
+    std::string _host;
+    std::string _port;
+    std::chrono::seconds _timeout;
+    std::uint32_t _sourceId;
+    std::size_t _window;
+    std::uint64_t _traceId;
+    std::uint64_t _sequence = 0;
+    std::uint64_t _acked    = 0;
+    std::vector<char> _payload;
+    beast::flat_buffer _acks;
+  };
+
+  using FrameClientEndpoint      = BasicFrameClientEndpoint<tcp>;
+  using LocalFrameClientEndpoint = BasicFrameClientEndpoint<local>;
+}  // namespace net
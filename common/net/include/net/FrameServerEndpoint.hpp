@@ -0,0 +1,241 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "logging/Logging.hpp"
+#include "net/BufferPool.hpp"
+#include "net/Framing.hpp"
+#include "net/Ingest.hpp"
+#include "net/Listen.hpp"
+
+namespace
+{
+  namespace beast = boost::beast;
+  namespace asio  = boost::asio;
+  namespace fs    = std::filesystem;
+  using tcp       = boost::asio::ip::tcp;
+  using local     = boost::asio::local::stream_protocol;
+}  // namespace
+
+namespace net
+{
+  // Server side of the binary framing protocol (see Framing.hpp), over TCP or a Unix domain socket.
+  template<typename Protocol>
+  struct BasicFrameServerEndpoint
+  {
+    using Acceptor = typename asio::use_awaitable_t<>::template as_default_on_t<typename Protocol::acceptor>;
+    using Socket   = typename asio::use_awaitable_t<>::template as_default_on_t<typename Protocol::socket>;
+
+    // `reusePort` lets the endpoints of several threads share a TCP port.
+    BasicFrameServerEndpoint(const exe::Executor auto& executor,
+                             Ingest& ingest,
+                             const typename Protocol::endpoint& endpoint,
+                             std::int64_t timeout,
+                             bool reusePort = false)
+        : _ingest{ ingest }, _acceptor{ executor }, _wheel{ executor }, _timeout{ timeout }
+    {
+      listen(_acceptor, bindable(endpoint), reusePort);
+    }
+
+    asio::awaitable<void> doListen()
+    {
+      auto executor = co_await asio::this_coro::executor;
+
+      try
+      {
+        while (_acceptor.is_open())
+        {
+          Socket socket{ co_await _acceptor.async_accept() };
+          if constexpr (std::is_same_v<Protocol, tcp>)
+          {
+            socket.set_option(tcp::no_delay{ true });
+          }
+
+          exe::submit(executor, doSession(std::move(socket)));
+        }
+      }
+      catch (boost::system::system_error& se)
+      {
+        if (se.code() != boost::system::errc::operation_canceled)
+          throw;
+      }
+
+      co_return;
+    }
+
+    void cancel() { _acceptor.cancel(); }
+
+  private:
+    static constexpr std::size_t ReadChunk = 64 * 1024;
+
+    // A socket file left behind by a previous run would make bind() fail.
+    static const typename Protocol::endpoint& bindable(const typename Protocol::endpoint& endpoint)
+    {
+      if constexpr (std::is_same_v<Protocol, local>)
+      {
+        fs::remove(endpoint.path());
+      }
+
+      return endpoint;
+    }
+
+    asio::awaitable<void> doSession(Socket socket)
+    {
+      auto buffer = _buffers.acquire();
+      buffer->clear();
+
+      exe::TimerWheel::Entry deadline{ [&socket]
+                                       {
+                                         boost::system::error_code ec;
+                                         socket.cancel(ec);
+                                       } };
+
+      const auto traceId = exe::trace::newId();
+      framing::AckHeader ack;
+      ack.magic = framing::AckMagic;
+
+      try
+      {
+        while (true)
+        {
+          _wheel.arm(deadline, _timeout);
+          auto transferred = co_await socket.async_read_some(buffer->prepare(nextReadSize(*buffer)));
+          buffer->commit(transferred);
+
+          std::size_t stored = 0;
+          std::uint64_t last = 0;
+          while (auto payload = nextFrame(*buffer))
+          {
+            exe::trace::Span span{ "store_frame", traceId, payload->sequence };
+            co_await _ingest(payload->data, payload->sourceId, payload->sequence, payload->timestamp);
+            last = payload->sequence;
+            buffer->consume(sizeof(framing::FrameHeader) + payload->data.size());
+            ++stored;
+          }
+
+          if (stored > 0)
+          {
+            ack.sequence = last;
+            co_await asio::async_write(socket, asio::buffer(&ack, sizeof(ack)));
+          }
+        }
+      }
+      catch (const std::invalid_argument& ex)
+      {
+        spdlog::warn("Closing frame connection: {}", ex.what());
+      }
+      catch (boost::system::system_error& se)
+      {
+        // Persistent connections sit idle between frames, a quiet peer is closed, not an error. Sessions end
+        // here, an exception escaping a detached session would take the process down.
+        if (deadline.expired())
+        {
+          if (buffer->size() == 0)
+          {
+            SPDLOG_DEBUG("Closing idle frame connection");
+          }
+          else
+          {
+            LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Frame connection timed out in the middle of a frame");
+          }
+        }
+        else if (!isDisconnect(se.code()))
+        {
+          LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Frame connection failed: {}", se.code().message());
+        }
+      }
+      catch (const std::exception& ex)
+      {
+        // A frame that can't be stored (a full disk, missing permissions) isn't acknowledged, the client sends it
+        // again once it reconnects.
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Closing frame connection, can't ingest frame: {}", ex.what());
+      }
+
+      boost::system::error_code ec;
+      socket.close(ec);
+      co_return;
+    }
+
+    static bool isDisconnect(const boost::system::error_code& ec)
+    {
+      return ec == asio::error::eof || ec == asio::error::connection_reset || ec == asio::error::broken_pipe
+             || ec == boost::system::errc::operation_canceled;
+    }
+
+    struct Payload
+    {
+      std::uint32_t sourceId;
+      std::uint64_t sequence;
+      std::uint64_t timestamp;
+      std::string_view data;
+    };
+
+    // Returns the next complete frame in the buffer, if any.
+    static std::optional<Payload> nextFrame(const beast::flat_buffer& buffer)
+    {
+      if (buffer.size() < sizeof(framing::FrameHeader))
+      {
+        return std::nullopt;
+      }
+
+      const auto* data = static_cast<const char*>(buffer.data().data());
+      framing::FrameHeader header;
+      std::memcpy(&header, data, sizeof(header));
+
+      if (header.magic.value() != framing::FrameMagic)
+      {
+        throw std::invalid_argument("bad frame magic");
+      }
+
+      if (header.length.value() > framing::MaxPayload)
+      {
+        throw std::invalid_argument("frame too large");
+      }
+
+      if (buffer.size() < sizeof(header) + header.length.value())
+      {
+        return std::nullopt;
+      }
+
+      return Payload{ header.sourceId.value(),
+                      header.sequence.value(),
+                      header.timestamp.value(),
+                      { data + sizeof(header), header.length.value() } };
+    }
+
+    // Reads the rest of a partially received frame in one go, otherwise a chunk that fits many small frames.
+    static std::size_t nextReadSize(const beast::flat_buffer& buffer)
+    {
+      if (buffer.size() >= sizeof(framing::FrameHeader))
+      {
+        framing::FrameHeader header;
+        std::memcpy(&header, buffer.data().data(), sizeof(header));
+
+        const std::size_t missing = sizeof(header) + header.length.value() - buffer.size();
+        return std::max(missing, ReadChunk);
+      }
+
+      return ReadChunk;
+    }
+
+    Ingest& _ingest;
+    Acceptor _acceptor;
+    exe::TimerWheel _wheel;
+    BufferPool<beast::flat_buffer> _buffers;
+    std::chrono::seconds _timeout;
+  };
+
+  using FrameServerEndpoint      = BasicFrameServerEndpoint<tcp>;
+  using LocalFrameServerEndpoint = BasicFrameServerEndpoint<local>;
+}  // namespace net
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <boost/endian/buffers.hpp>
+#include <chrono>
+#include <cstdint>
+
+namespace net::framing
+{
+  // Length-prefixed binary protocol used as a lighter alternative to the HTTP upload.
+  //
+  //   client -> server: FrameHeader followed by `length` bytes of JPEG data, back to back
+  //   server -> client: AckHeader, every frame up to and including `sequence` is stored
+  //
+  // Sequence numbers start at 1 and grow by one per frame on a connection. The server
+  // acknowledges once per batch of frames it read, so acks are cumulative.
+
+  inline constexpr std::uint32_t FrameMagic = 0x43414d31;  // "CAM1"
+  inline constexpr std::uint32_t AckMagic   = 0x41434b31;  // "ACK1"
+  inline constexpr std::uint32_t MaxPayload = 64u << 20;
+
+  struct FrameHeader
+  {
+    boost::endian::big_uint32_buf_t magic;
+    boost::endian::big_uint32_buf_t sourceId;
+    boost::endian::big_uint32_buf_t length;
+    boost::endian::big_uint64_buf_t sequence;
+    boost::endian::big_uint64_buf_t timestamp;  // Microseconds since the UNIX epoch
+  };
+
+  struct AckHeader
+  {
+    boost::endian::big_uint32_buf_t magic;
+    boost::endian::big_uint64_buf_t sequence;
+  };
+
+  static_assert(sizeof(FrameHeader) == 28);
+  static_assert(sizeof(AckHeader) == 12);
+
+  inline std::uint64_t timestampNow()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+}  // namespace net::framing
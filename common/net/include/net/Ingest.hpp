@@ -0,0 +1,83 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "net/Capture.hpp"
+#include "net/Storage.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+}  // namespace
+
+namespace net
+{
+  // A received frame after it has been stored. `data` is only valid until the stage returns, `path`
+  // is empty when the ingest does not store frames.
+  struct Frame
+  {
+    fs::path path;
+    std::uint32_t sourceId;
+    std::uint64_t sequence;
+    std::uint64_t timestamp;
+    std::string_view data;
+  };
+
+  // Everything that happens to a received frame before the endpoint acknowledges it: the frame is
+  // stored, then every stage is awaited in order. Shared by all endpoints of a server and only used
+  // from the executor they run on.
+  struct Ingest
+  {
+    using Stage = std::function<asio::awaitable<void>(const Frame&)>;
+
+    // Frames are only passed to the stages, e.g. by a relay that does not keep them.
+    Ingest() = default;
+    explicit Ingest(Storage& storage) : _storage{ &storage } { }
+
+    void addStage(Stage stage) { _stages.push_back(std::move(stage)); }
+
+    // Records every frame as it arrives, before it is stored.
+    void captureTo(capture::Writer& writer) { _capture = &writer; }
+
+    asio::awaitable<fs::path> operator()(std::string_view data,
+                                         std::uint32_t sourceId  = 0,
+                                         std::uint64_t sequence  = 0,
+                                         std::uint64_t timestamp = 0)
+    {
+      if (_capture)
+      {
+        _capture->record(data, sourceId);
+      }
+
+      Frame frame{ {}, sourceId, sequence, timestamp, data };
+      if (_storage)
+      {
+#if defined(BOOST_ASIO_HAS_FILE)
+        frame.path = co_await _storage->asyncStore(data, sourceId, timestamp);
+#else
+        frame.path = _storage->store(data, sourceId, timestamp);
+#endif
+      }
+
+      for (auto& stage : _stages)
+      {
+        co_await stage(frame);
+      }
+
+      co_return frame.path;
+    }
+
+    Storage* storage() noexcept { return _storage; }
+
+  private:
+    Storage* _storage = nullptr;
+    capture::Writer* _capture = nullptr;
+    std::vector<Stage> _stages;
+  };
+}  // namespace net
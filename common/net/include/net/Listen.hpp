@@ -0,0 +1,31 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <boost/asio.hpp>
+
+namespace
+{
+  namespace asio = boost::asio;
+}  // namespace
+
+namespace net
+{
+  using ReusePort = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+  // Same as constructing the acceptor from the endpoint. With `reusePort`, acceptors of several
+  // threads can listen on the same TCP port and the kernel spreads new connections across them.
+  template<typename Acceptor>
+  void listen(Acceptor& acceptor, const typename Acceptor::endpoint_type& endpoint, bool reusePort = false)
+  {
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(asio::socket_base::reuse_address{ true });
+    if (reusePort)
+    {
+      acceptor.set_option(ReusePort{ true });
+    }
+
+    acceptor.bind(endpoint);
+    acceptor.listen(asio::socket_base::max_listen_connections);
+  }
+}  // namespace net
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+}  // namespace
+
+namespace net
+{
+  // Frames that arrived in parts, for resumable uploads (see ServerEndpoint). The bytes received so far are kept in
+  // `<dir>/<upload id>` until the frame is complete, so a client that lost its connection only sends the rest.
+  // Shared by the endpoints of all threads. The file I/O runs one operation at a time on a thread of its own, the
+  // network threads only await the result.
+  struct PartialUploads
+  {
+    // Partial uploads untouched for `maxAge` are given up, at startup and then every hour: clients don't tell when
+    // they drop a frame.
+    explicit PartialUploads(fs::path dir, std::chrono::hours maxAge = std::chrono::hours{ 24 })
+        : _dir{ std::move(dir) }, _maxAge{ maxAge }
+    {
+      fs::create_directories(_dir);
+      expire();
+      scheduleExpiry();
+    }
+
+    ~PartialUploads()
+    {
+      asio::post(_pool, [this] { _expiry.cancel(); });
+      _pool.join();
+    }
+
+    // IDs are chosen by the clients and used as file names.
+    static bool validId(std::string_view id)
+    {
+      return !id.empty() && id.size() <= 64
+             && std::all_of(id.begin(), id.end(),
+                            [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; });
+    }
+
+    asio::awaitable<std::uint64_t> received(std::string_view id)
+    {
+      co_return co_await run([this, id] { return size(id); });
+    }
+
+    // Appends `data` if the upload stands at `offset`. Returns the number of bytes held afterwards, which is not
+    // `offset + data.size()` if the client is out of sync.
+    asio::awaitable<std::uint64_t> append(std::string_view id, std::uint64_t offset, std::string_view data)
+    {
+      co_return co_await run(
+          [this, id, offset, data]
+          {
+            const auto held = size(id);
+            if (held != offset || data.empty())
+            {
+              return held;
+            }
+
+            std::ofstream file{ path(id), std::ios::binary | std::ios::app };
+            if (!file.write(data.data(), static_cast<std::streamsize>(data.size())).flush())
+            {
+              // Whatever made it to the file still counts.
+              spdlog::warn("Can't keep partial upload {}", id);
+            }
+
+            return size(id);
+          });
+    }
+
+    // Returns the complete frame and forgets the upload.
+    asio::awaitable<std::string> take(std::string_view id)
+    {
+      co_return co_await run(
+          [this, id]
+          {
+            std::ifstream file{ path(id), std::ios::binary | std::ios::ate };
+            std::string data(static_cast<std::size_t>(std::max<std::streamoff>(file.tellg(), 0)), '\0');
+            file.seekg(0);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            file.close();
+
+            std::error_code ec;
+            fs::remove(path(id), ec);
+            return data;
+          });
+    }
+
+    // Doesn't wait for the file to be gone, later operations on the upload still see it removed.
+    void discard(std::string_view id)
+    {
+      asio::post(_pool,
+                 [this, id = std::string{ id }]
+                 {
+                   std::error_code ec;
+                   fs::remove(path(id), ec);
+                 });
+    }
+
+  private:
+    fs::path path(std::string_view id) const { return _dir / id; }
+
+    void expire()
+    {
+      const auto oldest = fs::file_time_type::clock::now() - _maxAge;
+      for (const auto& entry : fs::directory_iterator{ _dir })
+      {
+        std::error_code ec;
+        if (entry.last_write_time(ec) < oldest)
+        {
+          fs::remove(entry.path(), ec);
+        }
+      }
+    }
+
+    // Runs on the I/O thread, like every other operation on the files.
+    void scheduleExpiry()
+    {
+      _expiry.expires_after(std::chrono::hours{ 1 });
+      _expiry.async_wait(
+          [this](const boost::system::error_code& ec)
+          {
+            if (ec)
+            {
+              return;
+            }
+
+            try
+            {
+              expire();
+            }
+            catch (const std::exception& ex)
+            {
+              spdlog::warn("Can't expire partial uploads: {}", ex.what());
+            }
+
+            scheduleExpiry();
+          });
+    }
+
+    std::uint64_t size(std::string_view id) const
+    {
+      std::error_code ec;
+      const auto bytes = fs::file_size(path(id), ec);
+      return ec ? 0 : bytes;
+    }
+
+    // Arguments referenced by `function` stay valid, the caller awaits the result.
+    template<class Function>
+    asio::awaitable<std::invoke_result_t<Function>> run(Function function)
+    {
+      co_return co_await asio::co_spawn(
+          _pool, [function]() -> asio::awaitable<std::invoke_result_t<Function>> { co_return function(); },
+          asio::use_awaitable);
+    }
+
+    fs::path _dir;
+    std::chrono::hours _maxAge;
+    asio::thread_pool _pool{ 1 };
+    asio::steady_timer _expiry{ _pool };
+  };
+}  // namespace net
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "logging/Logging.hpp"
+#include "net/Framing.hpp"
+#include "net/Ingest.hpp"
+
+namespace
+{
+  namespace asio  = boost::asio;
+  namespace beast = boost::beast;
+  using tcp       = asio::ip::tcp;
+  using Resolver  = asio::use_awaitable_t<>::as_default_on_t<tcp::resolver>;
+}  // namespace
+
+namespace net
+{
+  // Forwards received frames to the binary port of an upstream server (see Framing.hpp) over a pool
+  // of persistent connections, so many cameras share a handful of upstream connections.
+  //
+  // Every connection has its own queue. Queued frames are written in batches of up to `batch` frames
+  // with one gathered write and stay queued until upstream acknowledges them; they are sent again
+  // after a reconnect, so a frame may arrive upstream twice but is not lost while the relay runs.
+  // A connection holds at most `maxQueued` bytes, forward() waits while all of them are full, which
+  // in turn stops the sessions from reading and pushes back on the cameras.
+  // One relay serves the endpoints of all network threads. It runs on its own (single-threaded)
+  // executor, forward() is the only member that may be called from others.
+  struct Relay
+  {
+    Relay(const exe::Executor auto& executor,
+          std::string host,
+          std::string port,
+          std::size_t connections,
+          std::int64_t timeout,
+          std::size_t maxQueued = 64 << 20,
+          std::size_t batch     = 16)
+        : _executor{ executor },
+          _space{ executor, asio::steady_timer::time_point::max() },
+          _wheel{ executor },
+          _host{ std::move(host) },
+          _port{ std::move(port) },
+          _timeout{ timeout },
+          _maxQueued{ maxQueued },
+          _batch{ std::max<std::size_t>(batch, 1) }
+    {
+      for (std::size_t i = 0; i < std::max<std::size_t>(connections, 1); ++i)
+      {
+        _upstreams.push_back(std::make_unique<Upstream>(executor, i));
+      }
+    }
+
+    // Keeps the connections up until cancelled.
+    asio::awaitable<void> run()
+    {
+      auto executor = co_await asio::this_coro::executor;
+
+      for (auto& upstream : _upstreams)
+      {
+        ++_running;
+        exe::submit(executor, connection(*upstream));
+      }
+
+      Timer stopped{ executor, asio::steady_timer::time_point::max() };
+      co_await stopped.async_wait();
+
+      cancel();
+
+      // The connections reference the relay, it must not go away before they are done.
+      co_await asio::this_coro::reset_cancellation_state();
+      while (_running > 0)
+      {
+        co_await _space.async_wait();
+      }
+    }
+
+    void cancel()
+    {
+      _stopped = true;
+      _space.cancel();
+
+      for (auto& upstream : _upstreams)
+      {
+        boost::system::error_code ec;
+        upstream->socket.close(ec);
+        upstream->ready.cancel();
+        upstream->backoff.cancel();
+      }
+    }
+
+    // Ingest stage, returns once the frame is queued on one of the connections. The frame is copied on
+    // the calling thread, the relay's executor only queues it.
+    asio::awaitable<void> forward(const Frame& frame)
+    {
+      Pending pending{ {}, std::string{ frame.data } };
+      pending.header.magic     = framing::FrameMagic;
+      pending.header.sourceId  = frame.sourceId;
+      pending.header.length    = static_cast<std::uint32_t>(frame.data.size());
+      pending.header.timestamp = frame.timestamp != 0 ? frame.timestamp : framing::timestampNow();
+
+      co_await asio::co_spawn(_executor, enqueue(std::move(pending)), asio::use_awaitable);
+    }
+
+  private:
+    using Socket = asio::use_awaitable_t<>::as_default_on_t<tcp::socket>;
+
+    struct Pending
+    {
+      framing::FrameHeader header;
+      std::string data;
+    };
+
+    struct Upstream
+    {
+      Upstream(const exe::Executor auto& executor, std::size_t index)
+          : socket{ executor },
+            ready{ executor, asio::steady_timer::time_point::max() },
+            backoff{ executor },
+            deadline{ [this]
+                      {
+                        boost::system::error_code ec;
+                        socket.cancel(ec);
+                      } },
+            index{ index }
+      {
+      }
+
+      Socket socket;
+      Timer ready;  // Cancelled when a frame is queued
+      Timer backoff;
+      exe::TimerWheel::Entry deadline;
+      std::size_t index;
+      bool connected = false;
+
+      std::deque<Pending> queued;    // Not written on the current connection yet
+      std::deque<Pending> inflight;  // Written, waiting for the ack
+      std::size_t bytes      = 0;    // Of all queued and in-flight frames
+      std::uint64_t sequence = 0;    // Last sequence number written on the current connection
+      std::uint64_t written  = 0;    // Last sequence number whose write completed
+      std::uint64_t acked    = 0;
+    };
+
+    Upstream& leastLoaded()
+    {
+      // Connected upstreams first, frames queued on the others wait for the reconnect.
+      return **std::min_element(_upstreams.begin(),
+                                _upstreams.end(),
+                                [](const auto& lhs, const auto& rhs)
+                                {
+                                  return std::make_pair(!lhs->connected, lhs->bytes)
+                                         < std::make_pair(!rhs->connected, rhs->bytes);
+                                });
+    }
+
+    asio::awaitable<void> enqueue(Pending pending)
+    {
+      while (!_stopped)
+      {
+        Upstream& upstream = leastLoaded();
+        if (upstream.bytes == 0 || upstream.bytes + pending.data.size() <= _maxQueued)
+        {
+          upstream.bytes += pending.data.size();
+          upstream.queued.push_back(std::move(pending));
+          upstream.ready.cancel();
+          co_return;
+        }
+
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "All upstream connections are full, delaying frames");
+        co_await _space.async_wait();
+      }
+    }
+
+    asio::awaitable<void> connection(Upstream& upstream)
+    {
+      while (!_stopped)
+      {
+        try
+        {
+          co_await connect(upstream);
+          spdlog::info("Relay connection {} to {}:{} established", upstream.index, _host, _port);
+
+          co_await exe::whenAll(writeFrames(upstream), readAcks(upstream));
+        }
+        catch (const std::exception& ex)
+        {
+          if (!_stopped)
+          {
+            LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 },
+                                  "Relay connection {} lost: {}",
+                                  upstream.index,
+                                  upstream.deadline.expired() ? "timeout" : ex.what());
+          }
+        }
+
+        disconnect(upstream);
+
+        if (!_stopped)
+        {
+          upstream.backoff.expires_after(std::chrono::seconds{ 1 });
+          co_await upstream.backoff.async_wait();
+        }
+      }
+
+      --_running;
+      _space.cancel();
+    }
+
+    asio::awaitable<void> connect(Upstream& upstream)
+    {
+      Resolver resolver{ upstream.socket.get_executor() };
+      auto const results = co_await resolver.async_resolve(_host, _port);
+
+      _wheel.arm(upstream.deadline, _timeout);
+      co_await asio::async_connect(upstream.socket, results);
+      _wheel.disarm(upstream.deadline);
+
+      upstream.socket.set_option(tcp::no_delay{ true });
+      upstream.connected = true;
+    }
+
+    // Frames that were not acknowledged go back to the front of the queue, sequence numbers are per
+    // connection.
+    void disconnect(Upstream& upstream)
+    {
+      boost::system::error_code ec;
+      upstream.socket.close(ec);
+      _wheel.disarm(upstream.deadline);
+
+      upstream.queued.insert(upstream.queued.begin(),
+                             std::make_move_iterator(upstream.inflight.begin()),
+                             std::make_move_iterator(upstream.inflight.end()));
+      upstream.inflight.clear();
+
+      upstream.connected = false;
+      upstream.sequence  = 0;
+      upstream.written   = 0;
+      upstream.acked     = 0;
+    }
+
+    asio::awaitable<void> writeFrames(Upstream& upstream)
+    {
+      auto state = co_await asio::this_coro::cancellation_state;
+      const auto traceId = exe::trace::newId();
+      std::vector<asio::const_buffer> buffers;
+
+      while (true)
+      {
+        while (upstream.queued.empty())
+        {
+          co_await upstream.ready.async_wait();
+
+          if (state.cancelled() != asio::cancellation_type::none || _stopped)
+          {
+            co_return;
+          }
+        }
+
+        buffers.clear();
+        const auto count = std::min(upstream.queued.size(), _batch);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          // Buffers point into `inflight`, whose elements keep their address until they are acked.
+          auto& pending = upstream.inflight.emplace_back(std::move(upstream.queued.front()));
+          upstream.queued.pop_front();
+
+          pending.header.sequence = ++upstream.sequence;
+          buffers.push_back(asio::buffer(&pending.header, sizeof(pending.header)));
+          buffers.push_back(asio::buffer(pending.data));
+        }
+
+        {
+          exe::trace::Span span{ "relay_batch", traceId, upstream.sequence };
+          if (!upstream.deadline.armed())
+          {
+            _wheel.arm(upstream.deadline, _timeout);
+          }
+
+          co_await asio::async_write(upstream.socket, buffers);
+        }
+
+        upstream.written = upstream.sequence;
+        release(upstream);
+      }
+    }
+
+    asio::awaitable<void> readAcks(Upstream& upstream)
+    {
+      beast::flat_buffer acks;
+
+      while (true)
+      {
+        auto transferred = co_await upstream.socket.async_read_some(acks.prepare(256));
+        acks.commit(transferred);
+
+        while (acks.size() >= sizeof(framing::AckHeader))
+        {
+          framing::AckHeader ack;
+          std::memcpy(&ack, acks.data().data(), sizeof(ack));
+          acks.consume(sizeof(ack));
+
+          if (ack.magic.value() != framing::AckMagic)
+          {
+            throw boost::system::system_error{ asio::error::invalid_argument };
+          }
+
+          upstream.acked = std::max(upstream.acked, ack.sequence.value());
+        }
+
+        release(upstream);
+      }
+    }
+
+    // Drops acknowledged frames. Frames of a write that is still in progress are kept until it
+    // completes, the write may still reference them.
+    void release(Upstream& upstream)
+    {
+      const auto last = std::min(upstream.acked, upstream.written);
+      bool released   = false;
+
+      while (!upstream.inflight.empty() && upstream.inflight.front().header.sequence.value() <= last)
+      {
+        upstream.bytes -= upstream.inflight.front().data.size();
+        upstream.inflight.pop_front();
+        released = true;
+      }
+
+      if (!released)
+      {
+        return;
+      }
+
+      // The deadline covers waiting for acks and is extended whenever upstream makes progress.
+      if (upstream.inflight.empty())
+      {
+        _wheel.disarm(upstream.deadline);
+      }
+      else
+      {
+        _wheel.arm(upstream.deadline, _timeout);
+      }
+
+      _space.cancel();
+    }
+
+    asio::any_io_executor _executor;
+    Timer _space;  // Cancelled when frames are acknowledged or a connection ends
+    exe::TimerWheel _wheel;
+    std::vector<std::unique_ptr<Upstream>> _upstreams;
+    std::string _host;
+    std::string _port;
+    std::chrono::seconds _timeout;
+    std::size_t _maxQueued;
+    std::size_t _batch;
+    std::size_t _running = 0;
+    bool _stopped        = false;
+  };
+}  // namespace net
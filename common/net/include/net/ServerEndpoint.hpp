@@ -6,10 +6,19 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <array>
+#include <charconv>
 #include <filesystem>
-#include <fstream>
+#include <memory_resource>
 
 #include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "logging/Logging.hpp"
+#include "net/BufferPool.hpp"
+#include "net/Ingest.hpp"
+#include "net/Listen.hpp"
+#include "net/PartialUploads.hpp"
 
 namespace
 {
@@ -24,11 +33,46 @@ namespace
 
 namespace net
 {
+  // Everything a connection needs to parse requests and build responses. Header fields of both live
+  // in a monotonic arena that is rewound per request, the read buffer and the body string keep
+  // their capacity, so a keep-alive upload does not allocate once the buffers are warmed up.
+  struct SessionBuffers
+  {
+    using Allocator = std::pmr::polymorphic_allocator<char>;
+    using Fields    = http::basic_fields<Allocator>;
+    using Request   = http::request<http::string_body, Fields>;
+    using Response  = http::response<http::span_body<const char>, Fields>;
+    using Parser    = http::request_parser<http::string_body, Allocator>;
+
+    static constexpr std::size_t ArenaSize = 8192;
+
+    Allocator rewind()
+    {
+      arena.release();
+      body.clear();
+      return Allocator{ &arena };
+    }
+
+    beast::flat_buffer read;
+    std::string body;
+    alignas(std::max_align_t) std::array<std::byte, ArenaSize> arenaStorage;
+    std::pmr::monotonic_buffer_resource arena{ arenaStorage.data(), arenaStorage.size() };
+  };
+
   struct ServerEndpoint
   {
-    ServerEndpoint(const exe::Executor auto& executor, const fs::path& storageDir, std::uint16_t port, std::int64_t timeout)
-        : _storageDir{ storageDir }, _acceptor{ executor, { tcp::v4(), port } }, _timeout{ timeout }, _sessionId{ 0ul }
+    // Beast limits request bodies to 1 MiB by default, which a chunked upload has no length for up front.
+    static constexpr std::uint64_t MaxBodySize = 64 * 1024 * 1024;
+
+    // `reusePort` lets the endpoints of several threads share the port.
+    ServerEndpoint(const exe::Executor auto& executor,
+                   Ingest& ingest,
+                   std::uint16_t port,
+                   std::int64_t timeout,
+                   bool reusePort = false)
+        : _ingest{ ingest }, _acceptor{ executor }, _wheel{ executor }, _timeout{ timeout }
     {
+      listen(_acceptor, { tcp::v4(), port }, reusePort);
     }
 
     asio::awaitable<void> doListen()
@@ -56,92 +100,318 @@ namespace net
 
     void cancel() { _acceptor.cancel(); }
 
+    // Accept resumable uploads: requests with an X-Upload-Id are kept in `partials` until complete.
+    //
+    //   HEAD /screenshot  X-Upload-Id                                  -> X-Upload-Offset: bytes held
+    //   POST /screenshot  X-Upload-Id, X-Upload-Offset, X-Upload-Length -> X-Upload-Offset: bytes held
+    //
+    // A POST carries the bytes from its offset on, the frame is ingested once all `length` bytes arrived. A
+    // connection that breaks off mid-body keeps what made it, so the retry only sends the rest. An offset that
+    // doesn't match is answered with 409 and the offset the client has to continue from. Without `partials`, a
+    // frame with an X-Upload-Id is only accepted in one go.
+    void resumeWith(PartialUploads& partials) { _partials = &partials; }
+
   private:
     asio::awaitable<void> doSession(TcpStream stream)
     {
-      beast::flat_buffer buffer;
+      auto buffers = _buffers.acquire();
+      exe::TimerWheel::Entry deadline{ [&stream]
+                                       {
+                                         boost::system::error_code ec;
+                                         stream.socket().cancel(ec);
+                                       } };
+
+      const auto traceId    = exe::trace::newId();
+      std::uint64_t frameId = 0;
+      exe::trace::Span session{ "session", traceId };
+
+      // Between requests a keep-alive connection may stay quiet until the deadline, that's not an error.
+      bool betweenRequests = true;
 
       try
       {
-        stream.expires_after(_timeout);
-        http::request<http::string_body> req;
-        co_await http::async_read(stream, buffer, req);
+        bool keepAlive = true;
+        while (keepAlive)
+        {
+          _wheel.arm(deadline, _timeout);
+          betweenRequests = true;
+
+          SessionBuffers::Parser parser{ std::piecewise_construct, std::make_tuple(), std::make_tuple(buffers->rewind()) };
+          parser.get().body() = std::move(buffers->body);
+          parser.body_limit(MaxBodySize);
+          {
+            exe::trace::Span span{ "read_header", traceId };
+            co_await http::async_read_header(stream, buffers->read, parser);
+            betweenRequests = false;
+            frameId         = parseFrameId(parser.get());
+            span.frame(frameId);
+            session.frame(frameId);
+          }
+
+          // Chunked uploads arrive while the client is still encoding, the body grows chunk by chunk.
+          boost::system::error_code broken;
+          {
+            exe::trace::Span span{ "read_body", traceId, frameId };
+            try
+            {
+              while (!parser.is_done())
+              {
+                _wheel.arm(deadline, _timeout);
+                co_await http::async_read_some(stream, buffers->read, parser);
+              }
+            }
+            catch (const boost::system::system_error& se)
+            {
+              broken = se.code();
+            }
+          }
 
-        http::message_generator msg = handleRequest(std::move(req));
+          // A client that went away mid-body keeps what made it and ends the session like any other disconnect.
+          if (broken)
+          {
+            co_await keepPartial(parser.get());
+            sessionEnded(broken, deadline.expired(), false);
+            break;
+          }
 
-        co_await beast::async_write(stream, std::move(msg));
+          SessionBuffers::Request req = parser.release();
+          SessionBuffers::Response res = co_await handleRequest(req, traceId, frameId);
+          buffers->body = std::move(req.body());
+          keepAlive     = res.keep_alive();
+
+          {
+            exe::trace::Span span{ "write_response", traceId, frameId };
+            co_await http::async_write(stream, res);
+          }
+        }
 
-        stream.socket().shutdown(tcp::socket::shutdown_send);
-        co_return;
       }
       catch (boost::system::system_error& se)
       {
-        if (se.code() != http::error::end_of_stream && se.code() != boost::system::errc::operation_canceled)
-          throw;
+        // Sessions end here, an exception escaping a detached session would take the process down.
+        sessionEnded(se.code(), deadline.expired(), betweenRequests);
+      }
+      catch (const std::exception& ex)
+      {
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Session failed: {}", ex.what());
       }
 
-      stream.socket().shutdown(tcp::socket::shutdown_send);
+      boost::system::error_code ec;
+      stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+      stream.socket().close(ec);
       co_return;
     }
 
+    // Clients going away, also in the middle of a request, are part of normal operation.
+    static bool isDisconnect(const boost::system::error_code& ec)
+    {
+      return ec == http::error::end_of_stream || ec == http::error::partial_message || ec == asio::error::eof
+             || ec == asio::error::connection_reset || ec == asio::error::broken_pipe
+             || ec == boost::system::errc::operation_canceled;
+    }
+
+    void sessionEnded(const boost::system::error_code& ec, bool timedOut, bool betweenRequests) const
+    {
+      if (timedOut)
+      {
+        if (betweenRequests)
+        {
+          SPDLOG_DEBUG("Closing idle connection");
+        }
+        else
+        {
+          LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Request timed out after {} s", _timeout.count());
+        }
+      }
+      else if (isDisconnect(ec))
+      {
+        SPDLOG_DEBUG("Client disconnected: {}", ec.message());
+      }
+      else
+      {
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Session failed: {}", ec.message());
+      }
+    }
+
+    // Frame ID sent by ClientEndpoint, only used to correlate client and server traces.
+    template<class Body, class Fields>
+    static std::uint64_t parseFrameId(const http::request<Body, Fields>& req)
+    {
+      std::uint64_t frameId = 0;
+      auto value            = req["X-Frame-Id"];
+      std::from_chars(value.data(), value.data() + value.size(), frameId);
+      return frameId;
+    }
+
+    // Optional, frames without it belong to source 0.
+    template<class Body, class Fields>
+    static std::uint32_t parseSourceId(const http::request<Body, Fields>& req)
+    {
+      std::uint32_t sourceId = 0;
+      auto value             = req["X-Source-Id"];
+      std::from_chars(value.data(), value.data() + value.size(), sourceId);
+      return sourceId;
+    }
+
+    template<class Body, class Fields>
+    static std::uint64_t parseNumber(const http::request<Body, Fields>& req, beast::string_view field)
+    {
+      std::uint64_t number = 0;
+      auto value           = req[field];
+      std::from_chars(value.data(), value.data() + value.size(), number);
+      return number;
+    }
+
+    template<class Body, class Fields>
+    static std::string_view parseUploadId(const http::request<Body, Fields>& req)
+    {
+      auto value = req["X-Upload-Id"];
+      return { value.data(), value.size() };
+    }
+
+    template<class Body, class Fields>
+    asio::awaitable<void> keepPartial(const http::request<Body, Fields>& req)
+    {
+      const auto uploadId = parseUploadId(req);
+      if (_partials && req.method() == http::verb::post && PartialUploads::validId(uploadId))
+      {
+        co_await _partials->append(uploadId, parseNumber(req, "X-Upload-Offset"), req.body());
+      }
+    }
+
+    // Responses share the request's allocator and only reference static bodies.
     template<class Body, class Allocator>
-    http::message_generator handleRequest(http::request<Body, http::basic_fields<Allocator>>&& req)
+    asio::awaitable<http::response<http::span_body<const char>, http::basic_fields<Allocator>>> handleRequest(
+        const http::request<Body, http::basic_fields<Allocator>>& req,
+        std::uint64_t traceId,
+        std::uint64_t frameId)
     {
-      // Returns a bad request response
-      auto const bad_request = [&req](beast::string_view why)
+      exe::trace::Span span{ "handle_request", traceId, frameId };
+
+      auto const response = [&req](http::status status)
       {
-        http::response<http::string_body> res{ http::status::bad_request, req.version() };
+        http::response<http::span_body<const char>, http::basic_fields<Allocator>> res{
+          std::piecewise_construct, std::make_tuple(), std::make_tuple(req.get_allocator())
+        };
+        res.result(status);
+        res.version(req.version());
         res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, "text/html");
         res.keep_alive(req.keep_alive());
-        res.body() = std::string(why);
-        res.prepare_payload();
         return res;
       };
 
-      // Returns a server error response
-      auto const server_error = [&req](beast::string_view what)
+      // Returns a bad request response, `why` has to be a string literal
+      auto const bad_request = [&response](beast::string_view why)
       {
-        http::response<http::string_body> res{ http::status::internal_server_error, req.version() };
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        auto res = response(http::status::bad_request);
         res.set(http::field::content_type, "text/html");
-        res.keep_alive(req.keep_alive());
-        res.body() = "An error occurred: '" + std::string(what) + "'";
+        res.body() = { why.data(), why.size() };
         res.prepare_payload();
         return res;
       };
 
-      if (req.method() != http::verb::post)
-        return bad_request("Unknown HTTP-method");
-
       if (req.target() != "/screenshot")
-        return bad_request("Illegal request-target");
+        co_return bad_request("Illegal request-target");
 
-      if (req.body().size() == 0)
+      // A frame that can't be stored (a full disk, missing permissions) fails its own request, not the server.
+      try
       {
-        return bad_request("Invalid image");
+        if (req.count("X-Upload-Id") != 0)
+          co_return co_await handleResumable(req, frameId, response, bad_request);
+
+        if (req.method() != http::verb::post)
+          co_return bad_request("Unknown HTTP-method");
+
+        if (req.body().size() == 0)
+        {
+          co_return bad_request("Invalid image");
+        }
+
+        co_await _ingest(req.body(), parseSourceId(req), frameId);
       }
+      catch (const std::exception& ex)
+      {
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Can't ingest frame: {}", ex.what());
 
-      auto imageName = fmt::format("recimage{}.jpg", _sessionId++);
+        auto res = response(http::status::internal_server_error);
+        res.prepare_payload();
+        co_return res;
+      }
+
+      auto res = response(http::status::ok);
+      res.prepare_payload();
+
+      co_return res;
+    }
+
+    template<class Body, class Fields, class Response, class BadRequest>
+    asio::awaitable<std::invoke_result_t<Response, http::status>> handleResumable(const http::request<Body, Fields>& req,
+                                                                                  std::uint64_t frameId,
+                                                                                  const Response& response,
+                                                                                  const BadRequest& bad_request)
+    {
+      const auto uploadId = parseUploadId(req);
+      if (!PartialUploads::validId(uploadId))
+        co_return bad_request("Invalid upload ID");
+
+      auto const offsetResponse = [&response](http::status status, std::uint64_t offset)
+      {
+        auto res = response(status);
+        res.set("X-Upload-Offset", std::to_string(offset));
+        res.prepare_payload();
+        return res;
+      };
 
-      std::ofstream file{ _storageDir / imageName, std::ios::binary };
-      if (!file.is_open())
+      if (req.method() == http::verb::head)
       {
-        throw std::runtime_error("Can't open file for writing");
+        std::uint64_t received = 0;
+        if (_partials)
+          received = co_await _partials->received(uploadId);
+
+        co_return offsetResponse(http::status::ok, received);
       }
 
-      file << req.body();
+      if (req.method() != http::verb::post)
+        co_return bad_request("Unknown HTTP-method");
+
+      const auto offset = parseNumber(req, "X-Upload-Offset");
+      const auto length = parseNumber(req, "X-Upload-Length");
+      // Both numbers come from the client: bounded before anything is added up, so nothing wraps around and no
+      // upload reserves more partial storage than a frame may take.
+      if (length == 0 || length > MaxBodySize || offset > length || req.body().size() > length - offset)
+        co_return bad_request("Invalid upload range");
 
-      http::response<http::empty_body> res{ http::status::ok, req.version() };
-      res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-      res.keep_alive(req.keep_alive());
+      // The common case, a frame that arrives in one go, never touches the disk.
+      if (offset == 0 && req.body().size() == length)
+      {
+        if (_partials)
+          _partials->discard(uploadId);
+
+        co_await _ingest(req.body(), parseSourceId(req), frameId);
+        co_return offsetResponse(http::status::ok, length);
+      }
+
+      // Without a place to keep them, parts are refused and the client sends the frame in one go.
+      if (!_partials)
+        co_return offsetResponse(http::status::conflict, 0);
+
+      const auto received = co_await _partials->append(uploadId, offset, req.body());
+      if (received != offset + req.body().size())
+        co_return offsetResponse(http::status::conflict, received);
+
+      if (received == length)
+      {
+        co_await _ingest(co_await _partials->take(uploadId), parseSourceId(req), frameId);
+      }
 
-      return res;
+      co_return offsetResponse(http::status::ok, received);
     }
 
-    fs::path _storageDir;
+    Ingest& _ingest;
+    PartialUploads* _partials = nullptr;
     Acceptor _acceptor;
+    exe::TimerWheel _wheel;
+    BufferPool<SessionBuffers> _buffers;
     std::chrono::seconds _timeout;
-    std::size_t _sessionId;
   };
 }  // namespace net
\ No newline at end of file
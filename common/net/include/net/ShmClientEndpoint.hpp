@@ -0,0 +1,164 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+#include "exe/Exe.hpp"
+#include "exe/TimerWheel.hpp"
+#include "exe/Trace.hpp"
+#include "net/Framing.hpp"
+#include "net/ShmRing.hpp"
+
+namespace
+{
+  namespace asio  = boost::asio;
+  namespace beast = boost::beast;
+  namespace fs    = std::filesystem;
+  using local     = asio::local::stream_protocol;
+  using FileDesc  = asio::use_awaitable_t<>::as_default_on_t<asio::posix::stream_descriptor>;
+}  // namespace
+
+namespace net
+{
+  // Producer side of the shared memory transport (see ShmRing.hpp) for a server on the same host.
+  // Frames are read from disk straight into a ring slot; the socket only carries the handshake.
+  struct ShmClientEndpoint
+  {
+    ShmClientEndpoint(const exe::Executor auto& executor,
+                      fs::path controlPath,
+                      std::int64_t timeout,
+                      std::uint32_t sourceId,
+                      std::uint32_t slotCount = 16,
+                      std::size_t slotSize    = 8u << 20)
+        : _control{ executor },
+          _dataReady{ executor },
+          _slotFree{ executor },
+          _wheel{ executor },
+          _deadline{ [this]
+                     {
+                       boost::system::error_code ec;
+                       _slotFree.cancel(ec);
+                     } },
+          _controlPath{ std::move(controlPath) },
+          _timeout{ timeout },
+          _sourceId{ sourceId },
+          _slotCount{ slotCount },
+          _slotSize{ slotSize },
+          _traceId{ exe::trace::newId() }
+    {
+    }
+
+    asio::awaitable<void> sendFile(fs::path imagePath)
+    {
+      try
+      {
+        if (!_ring)
+        {
+          co_await connect();
+        }
+
+        auto& header    = _ring->header();
+        const auto head = header.head.load(std::memory_order_relaxed);
+
+        while (head - header.tail.load(std::memory_order_acquire) >= _ring->slotCount())
+        {
+          exe::trace::Span span{ "wait_slot", _traceId, head + 1 };
+          _wheel.arm(_deadline, _timeout);
+          co_await _slotFree.async_wait(asio::posix::stream_descriptor::wait_read);
+          shm::drain(_slotFree.native_handle());
+        }
+        _wheel.disarm(_deadline);
+
+        {
+          exe::trace::Span span{ "fill_slot", _traceId, head + 1 };
+
+          auto& slot     = _ring->slot(head);
+          slot.sourceId  = _sourceId;
+          slot.length    = readFile(imagePath, _ring->payload(head));
+          slot.sequence  = head + 1;
+          slot.timestamp = framing::timestampNow();
+        }
+
+        header.head.store(head + 1, std::memory_order_release);
+        shm::signal(_dataReady.native_handle());
+      }
+      catch (boost::system::system_error& se)
+      {
+        const bool timedOut = _deadline.expired();
+        _wheel.disarm(_deadline);
+        close();
+
+        if (timedOut)
+          throw boost::system::system_error{ beast::error::timeout };
+
+        if (se.code() != boost::system::errc::operation_canceled)
+          throw;
+      }
+
+      co_return;
+    }
+
+  private:
+    asio::awaitable<void> connect()
+    {
+      auto ring = shm::Ring::create(_slotCount, _slotSize);
+      _dataReady.assign(shm::makeEventFd());
+      _slotFree.assign(shm::makeEventFd());
+
+      co_await _control.async_connect(local::endpoint{ _controlPath.string() });
+
+      const shm::Hello hello{ shm::HelloMagic, _sourceId };
+      const std::array<int, 3> fds{ ring.fd(), _dataReady.native_handle(), _slotFree.native_handle() };
+      shm::sendDescriptors(_control.native_handle(), hello, fds);
+
+      _ring.emplace(std::move(ring));
+    }
+
+    std::uint32_t readFile(const fs::path& imagePath, std::span<char> slot)
+    {
+      std::ifstream file{ imagePath, std::ios::binary | std::ios::ate };
+      if (!file.is_open())
+      {
+        throw std::runtime_error("Can't open image file");
+      }
+
+      const auto size = static_cast<std::size_t>(file.tellg());
+      if (size > slot.size())
+      {
+        throw std::runtime_error("Image doesn't fit into a shared memory slot");
+      }
+
+      file.seekg(0);
+      file.read(slot.data(), static_cast<std::streamsize>(size));
+      return static_cast<std::uint32_t>(size);
+    }
+
+    void close()
+    {
+      boost::system::error_code ec;
+      _control.close(ec);
+      _dataReady.close(ec);
+      _slotFree.close(ec);
+      _ring.reset();
+    }
+
+    asio::use_awaitable_t<>::as_default_on_t<local::socket> _control;
+    FileDesc _dataReady;
+    FileDesc _slotFree;
+    exe::TimerWheel _wheel;
+    exe::TimerWheel::Entry _deadline;
+    std::optional<shm::Ring> _ring;
+    fs::path _controlPath;
+    std::chrono::seconds _timeout;
+    std::uint32_t _sourceId;
+    std::uint32_t _slotCount;
+    std::size_t _slotSize;
+    std::uint64_t _traceId;
+  };
+}  // namespace net
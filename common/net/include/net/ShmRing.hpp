@@ -0,0 +1,285 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace net::shm
+{
+  // Single producer / single consumer ring of fixed size frame slots in a memfd mapping, used to
+  // hand frames from a co-located client to the server without going through a socket.
+  //
+  // The client creates the ring and two eventfds ("data ready" and "slot free") and passes all three
+  // descriptors to the server over a Unix domain socket (SCM_RIGHTS). The client copies a frame into
+  // the slot at `head` and bumps `head`, the server stores the frame straight from the mapping and
+  // bumps `tail`; each side signals the other's eventfd after publishing.
+
+  inline constexpr std::uint32_t RingMagic  = 0x52494e47;  // "RING"
+  inline constexpr std::uint32_t HelloMagic = 0x53484d31;  // "SHM1"
+
+  struct RingHeader
+  {
+    std::uint32_t magic;
+    std::uint32_t slotCount;
+    std::uint64_t slotSize;
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+  };
+
+  struct SlotHeader
+  {
+    std::uint32_t sourceId;
+    std::uint32_t length;
+    std::uint64_t sequence;
+    std::uint64_t timestamp;
+  };
+
+  // Sent together with the descriptors when the client connects.
+  struct Hello
+  {
+    std::uint32_t magic;
+    std::uint32_t sourceId;
+  };
+
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Ring indices have to be address-free");
+
+  [[noreturn]] inline void throwErrno(const char* what)
+  {
+    throw std::system_error{ errno, std::generic_category(), what };
+  }
+
+  struct Ring
+  {
+    static Ring create(std::uint32_t slotCount, std::size_t slotSize)
+    {
+      const int fd = ::memfd_create("camera_asio_ring", MFD_CLOEXEC);
+      if (fd < 0)
+      {
+        throwErrno("memfd_create");
+      }
+
+      const auto size = mappingSize(slotCount, slotSize);
+      if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+      {
+        ::close(fd);
+        throwErrno("ftruncate");
+      }
+
+      Ring ring{ fd, size };
+      auto* header = new (ring._memory) RingHeader{};
+      header->magic     = RingMagic;
+      header->slotCount = slotCount;
+      header->slotSize  = slotSize;
+      header->head.store(0, std::memory_order_relaxed);
+      header->tail.store(0, std::memory_order_relaxed);
+
+      ring._slotCount = slotCount;
+      ring._slotSize  = slotSize;
+      return ring;
+    }
+
+    // Takes ownership of `fd`.
+    static Ring attach(int fd)
+    {
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(RingHeader))
+      {
+        ::close(fd);
+        throw std::runtime_error("Invalid shared memory ring");
+      }
+
+      Ring ring{ fd, static_cast<std::size_t>(st.st_size) };
+      const auto& header = ring.header();
+      if (header.magic != RingMagic || header.slotCount == 0 || mappingSize(header.slotCount, header.slotSize) > ring._size)
+      {
+        throw std::runtime_error("Invalid shared memory ring");
+      }
+
+      // The mapping is writable by the peer, so the geometry is only trusted once.
+      ring._slotCount = header.slotCount;
+      ring._slotSize  = header.slotSize;
+      return ring;
+    }
+
+    Ring(Ring&& other) noexcept
+        : _fd{ std::exchange(other._fd, -1) },
+          _size{ std::exchange(other._size, 0) },
+          _memory{ std::exchange(other._memory, nullptr) },
+          _slotCount{ other._slotCount },
+          _slotSize{ other._slotSize }
+    {
+    }
+
+    Ring& operator=(Ring&& other) noexcept
+    {
+      std::swap(_fd, other._fd);
+      std::swap(_size, other._size);
+      std::swap(_memory, other._memory);
+      std::swap(_slotCount, other._slotCount);
+      std::swap(_slotSize, other._slotSize);
+      return *this;
+    }
+
+    ~Ring() noexcept
+    {
+      if (_memory)
+      {
+        ::munmap(_memory, _size);
+      }
+
+      if (_fd >= 0)
+      {
+        ::close(_fd);
+      }
+    }
+
+    int fd() const noexcept { return _fd; }
+    RingHeader& header() const noexcept { return *static_cast<RingHeader*>(_memory); }
+    std::uint32_t slotCount() const noexcept { return _slotCount; }
+    std::size_t slotSize() const noexcept { return _slotSize; }
+
+    SlotHeader& slot(std::uint64_t index) const noexcept { return *reinterpret_cast<SlotHeader*>(slotBase(index)); }
+
+    std::span<char> payload(std::uint64_t index) const noexcept
+    {
+      return { slotBase(index) + sizeof(SlotHeader), slotSize() };
+    }
+
+  private:
+    Ring(int fd, std::size_t size) : _fd{ fd }, _size{ size }
+    {
+      _memory = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+      if (_memory == MAP_FAILED)
+      {
+        _memory = nullptr;
+        ::close(_fd);
+        _fd = -1;
+        throwErrno("mmap");
+      }
+    }
+
+    static std::size_t slotStride(std::size_t slotSize) noexcept
+    {
+      return (sizeof(SlotHeader) + slotSize + 63) & ~std::size_t{ 63 };
+    }
+
+    static std::size_t mappingSize(std::uint32_t slotCount, std::size_t slotSize) noexcept
+    {
+      return sizeof(RingHeader) + slotCount * slotStride(slotSize);
+    }
+
+    char* slotBase(std::uint64_t index) const noexcept
+    {
+      return static_cast<char*>(_memory) + sizeof(RingHeader) + (index % slotCount()) * slotStride(slotSize());
+    }
+
+    int _fd;
+    std::size_t _size;
+    void* _memory = nullptr;
+    std::uint32_t _slotCount = 0;
+    std::size_t _slotSize    = 0;
+  };
+
+  inline int makeEventFd()
+  {
+    const int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+      throwErrno("eventfd");
+    }
+
+    return fd;
+  }
+
+  inline void signal(int eventFd) noexcept
+  {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(eventFd, &one, sizeof(one));
+  }
+
+  // Resets the counter so that the next wait blocks until the peer signals again.
+  inline void drain(int eventFd) noexcept
+  {
+    std::uint64_t counter;
+    [[maybe_unused]] auto read = ::read(eventFd, &counter, sizeof(counter));
+  }
+
+  inline void sendDescriptors(int socket, const Hello& hello, std::span<const int> fds)
+  {
+    std::array<char, CMSG_SPACE(sizeof(int) * 3)> control{};
+    iovec iov{ const_cast<Hello*>(&hello), sizeof(hello) };
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr* cmsg   = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    if (::sendmsg(socket, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(hello)))
+    {
+      throwErrno("sendmsg");
+    }
+  }
+
+  // Returns the number of received descriptors, the caller owns them.
+  inline std::size_t receiveDescriptors(int socket, Hello& hello, std::span<int> fds)
+  {
+    std::array<char, CMSG_SPACE(sizeof(int) * 3)> control{};
+    iovec iov{ &hello, sizeof(hello) };
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = control.size();
+
+    if (::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(hello)))
+    {
+      throwErrno("recvmsg");
+    }
+
+    std::size_t received = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+        const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          int fd;
+          std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+          if (received < fds.size())
+          {
+            fds[received++] = fd;
+          }
+          else
+          {
+            ::close(fd);
+          }
+        }
+      }
+    }
+
+    return received;
+  }
+}  // namespace net::shm
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <boost/asio.hpp>
+#include <filesystem>
+#include <string_view>
+
+#include "exe/Exe.hpp"
+#include "exe/Trace.hpp"
+#include "logging/Logging.hpp"
+#include "net/ShmRing.hpp"
+#include "net/Ingest.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+  using local    = asio::local::stream_protocol;
+  using FileDesc = asio::use_awaitable_t<>::as_default_on_t<asio::posix::stream_descriptor>;
+}  // namespace
+
+namespace net
+{
+  // Consumer side of the shared memory transport (see ShmRing.hpp). Clients connect to a Unix domain
+  // socket to hand over their ring; frames are then stored directly from the shared mapping.
+  struct ShmServerEndpoint
+  {
+    using Acceptor = asio::use_awaitable_t<>::as_default_on_t<local::acceptor>;
+    using Socket   = asio::use_awaitable_t<>::as_default_on_t<local::socket>;
+
+    ShmServerEndpoint(const exe::Executor auto& executor, Ingest& ingest, const fs::path& controlPath)
+        : _ingest{ ingest }, _acceptor{ executor, bindable(controlPath) }
+    {
+    }
+
+    asio::awaitable<void> doListen()
+    {
+      auto executor = co_await asio::this_coro::executor;
+
+      try
+      {
+        while (_acceptor.is_open())
+        {
+          Socket control{ co_await _acceptor.async_accept() };
+
+          exe::submit(executor, doSession(std::move(control)));
+        }
+      }
+      catch (boost::system::system_error& se)
+      {
+        if (se.code() != boost::system::errc::operation_canceled)
+          throw;
+      }
+
+      co_return;
+    }
+
+    void cancel() { _acceptor.cancel(); }
+
+  private:
+    static local::endpoint bindable(const fs::path& controlPath)
+    {
+      fs::remove(controlPath);
+      return local::endpoint{ controlPath.string() };
+    }
+
+    asio::awaitable<void> doSession(Socket control)
+    {
+      auto executor      = co_await asio::this_coro::executor;
+      const auto traceId = exe::trace::newId();
+
+      try
+      {
+        co_await control.async_wait(local::socket::wait_read);
+
+        shm::Hello hello{};
+        std::array<int, 3> fds{ -1, -1, -1 };
+        const auto received = shm::receiveDescriptors(control.native_handle(), hello, fds);
+
+        // Adopt whatever was received before validating, so nothing leaks on error.
+        FileDesc dataReady{ executor };
+        FileDesc slotFree{ executor };
+        if (received == fds.size())
+        {
+          dataReady.assign(fds[1]);
+          slotFree.assign(fds[2]);
+        }
+        else
+        {
+          for (std::size_t i = 0; i < received; ++i)
+          {
+            ::close(fds[i]);
+          }
+        }
+
+        if (received != fds.size() || hello.magic != shm::HelloMagic)
+        {
+          spdlog::warn("Rejecting shared memory client: invalid handshake");
+          co_return;
+        }
+
+        auto ring    = shm::Ring::attach(fds[0]);
+        auto& header = ring.header();
+        auto tail    = header.tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+          // The control socket only becomes readable again when the client goes away.
+          auto woken = co_await (dataReady.async_wait(FileDesc::wait_read) || control.async_wait(Socket::wait_read));
+          if (woken.index() == 1)
+          {
+            break;
+          }
+
+          shm::drain(dataReady.native_handle());
+
+          const auto head = header.head.load(std::memory_order_acquire);
+          if (head - tail > ring.slotCount())
+          {
+            spdlog::warn("Closing shared memory session: corrupted ring indices");
+            break;
+          }
+
+          for (; tail != head; ++tail)
+          {
+            const auto& slot = ring.slot(tail);
+            exe::trace::Span span{ "store_slot", traceId, slot.sequence };
+
+            const std::uint32_t length = slot.length;
+            if (length > ring.slotSize())
+            {
+              spdlog::warn("Dropping shared memory frame {}: invalid length", slot.sequence);
+            }
+            else
+            {
+              co_await _ingest({ ring.payload(tail).data(), length }, slot.sourceId, slot.sequence, slot.timestamp);
+            }
+
+            header.tail.store(tail + 1, std::memory_order_release);
+          }
+
+          shm::signal(slotFree.native_handle());
+        }
+      }
+      catch (boost::system::system_error& se)
+      {
+        // Sessions end here, an exception escaping a detached session would take the process down.
+        if (se.code() != boost::system::errc::operation_canceled)
+        {
+          LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Shared memory session failed: {}", se.code().message());
+        }
+      }
+      catch (const std::exception& ex)
+      {
+        // E.g. a client handing over a ring that doesn't validate, or a frame that can't be stored.
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Shared memory session failed: {}", ex.what());
+      }
+
+      boost::system::error_code ec;
+      control.close(ec);
+      co_return;
+    }
+
+    Ingest& _ingest;
+    Acceptor _acceptor;
+  };
+}  // namespace net
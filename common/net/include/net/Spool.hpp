@@ -0,0 +1,185 @@
+#pragma once
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+  namespace fs = std::filesystem;
+}  // namespace
+
+namespace net
+{
+  // Frames waiting for upload, for ClientEndpoint::sendResumable. A frame is recorded in an append-only manifest
+  // before it is sent and marked done once the server has all of it, so a restarted client continues where it
+  // stopped:
+  //
+  //   + <sequence> <path>
+  //   - <sequence>
+  //   = <next sequence>
+  //
+  // The manifest is rewritten with the pending frames when the spool is opened, and emptied once it runs dry. A
+  // rewritten manifest starts with the next sequence, so sequences never repeat even when no frame is pending.
+  // Upload IDs are `<spool id>-<sequence>`, with a random spool ID kept in `<dir>/id`: the server may still hold
+  // part of an upload the client gave up on, a reused ID would continue from it.
+  struct Spool
+  {
+    struct Entry
+    {
+      std::uint64_t sequence;
+      fs::path path;
+      std::string uploadId;
+      bool attempted = false;  // The server may hold part of it
+    };
+
+    // Manifests shorter than this aren't worth emptying.
+    static constexpr std::size_t CompactLines = 1024;
+
+    explicit Spool(fs::path dir) : _dir{ std::move(dir) }
+    {
+      fs::create_directories(_dir);
+      loadId();
+      load();
+      rewrite();
+    }
+
+    bool empty() const noexcept { return _pending.empty(); }
+    std::size_t size() const noexcept { return _pending.size(); }
+
+    // Stays valid while frames are added.
+    Entry& front() { return _pending.front(); }
+
+    void add(fs::path frame)
+    {
+      const auto sequence = _next++;
+      write(fmt::format("+ {} {}\n", sequence, frame.string()));
+      _pending.push_back({ sequence, std::move(frame), uploadId(sequence) });
+    }
+
+    // The front frame arrived (or has to be given up).
+    void done()
+    {
+      write(fmt::format("- {}\n", _pending.front().sequence));
+      _pending.pop_front();
+
+      if (_pending.empty() && _lines >= CompactLines)
+      {
+        rewrite();
+      }
+    }
+
+  private:
+    std::string uploadId(std::uint64_t sequence) const { return fmt::format("{:016x}-{}", _id, sequence); }
+
+    void loadId()
+    {
+      if (std::ifstream in{ _dir / "id" }; in >> std::hex >> _id)
+      {
+        return;
+      }
+
+      std::random_device random;
+      _id = (static_cast<std::uint64_t>(random()) << 32) | random();
+
+      std::ofstream out{ _dir / "id" };
+      if (!(out << std::hex << _id << '\n'))
+      {
+        throw std::runtime_error("Can't create spool");
+      }
+    }
+
+    void load()
+    {
+      std::ifstream in{ _dir / "manifest" };
+      std::string line;
+      while (std::getline(in, line))
+      {
+        std::istringstream fields{ line };
+        char op;
+        std::uint64_t sequence;
+        if (!(fields >> op >> sequence))
+        {
+          continue;  // Cut short by a crash
+        }
+
+        if (op == '=')
+        {
+          _next = std::max(_next, sequence);
+          continue;
+        }
+
+        _next = std::max(_next, sequence + 1);
+        if (op == '+')
+        {
+          std::string path;
+          std::getline(fields >> std::ws, path);
+
+          // Frames of an earlier run may have partly arrived.
+          _pending.push_back({ sequence, path, uploadId(sequence), true });
+        }
+        else if (op == '-')
+        {
+          std::erase_if(_pending, [sequence](const Entry& entry) { return entry.sequence == sequence; });
+        }
+      }
+    }
+
+    // Replaces the manifest with the pending frames only.
+    void rewrite()
+    {
+      _manifest.close();
+
+      const auto manifest = _dir / "manifest";
+      const auto temporary = _dir / "manifest.tmp";
+      {
+        std::ofstream out{ temporary, std::ios::trunc };
+        out << fmt::format("= {}\n", _next);
+        for (const auto& entry : _pending)
+        {
+          out << fmt::format("+ {} {}\n", entry.sequence, entry.path.string());
+        }
+
+        if (!out.flush())
+        {
+          throw std::runtime_error("Can't write spool manifest");
+        }
+      }
+
+      fs::rename(temporary, manifest);
+      _lines = _pending.size() + 1;
+
+      _manifest.open(manifest, std::ios::app);
+      if (!_manifest.is_open())
+      {
+        throw std::runtime_error("Can't open spool manifest");
+      }
+    }
+
+    // Flushed per line, so a crashed client loses at most the line being written.
+    void write(const std::string& line)
+    {
+      if (!_manifest.write(line.data(), static_cast<std::streamsize>(line.size())).flush())
+      {
+        throw std::runtime_error("Can't write spool manifest");
+      }
+
+      ++_lines;
+    }
+
+    fs::path _dir;
+    std::uint64_t _id = 0;
+    std::uint64_t _next = 0;
+    std::deque<Entry> _pending;
+    std::ofstream _manifest;
+    std::size_t _lines = 0;
+  };
+}  // namespace net
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+}  // namespace
+
+namespace net
+{
+  // Writes received frames below the storage directory, shared by all endpoints of a server.
+  //
+  // Frames are sharded as `src<source>/<YYYY-MM-DD>/<HH>/<id>.jpg` (UTC) so that no directory grows without bound.
+  // IDs are monotonic across restarts: blocks of IDs are reserved in `.nextid` before they are handed out.
+  //
+  // With a retention limit the oldest frames form a ring: once the limit is reached, the oldest file is renamed to
+  // the new frame's path and overwritten in place instead of creating and unlinking a file per frame. New files are
+  // preallocated with fallocate() so their blocks are reused by later frames of a similar size.
+  //
+  // Thread-safe: picking the path of a frame is serialized, the data is written without holding the lock. Frames
+  // join the ring once written, so a frame that is still being written is never recycled.
+  struct Storage
+  {
+    using Observer = std::function<void(const fs::path& frame, std::string_view data)>;
+
+    // `retention` is the maximal number of kept frames (0 keeps everything), `preallocate` the number of bytes
+    // reserved for every file (0 disables preallocation).
+    explicit Storage(fs::path storageDir, std::size_t retention = 0, std::size_t preallocate = 0)
+        : _storageDir{ std::move(storageDir) }, _retention{ retention }, _preallocate{ preallocate }
+    {
+      fs::create_directories(_storageDir);
+      recover();
+    }
+
+    // `timestamp` is in microseconds since the UNIX epoch, 0 stands for now.
+    fs::path store(std::string_view data, std::uint32_t sourceId = 0, std::uint64_t timestamp = 0)
+    {
+      auto target = prepare(sourceId, timestamp);
+
+      try
+      {
+        const int fd     = open(target);
+        const char* next = data.data();
+        auto remaining   = data.size();
+        while (remaining > 0)
+        {
+          const auto written = ::pwrite(fd, next, remaining, static_cast<off_t>(next - data.data()));
+          if (written < 0)
+          {
+            if (errno == EINTR)
+            {
+              continue;
+            }
+
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error{ error, std::generic_category(), "Can't write frame" };
+          }
+
+          next += written;
+          remaining -= static_cast<std::size_t>(written);
+        }
+
+        finish(fd, target, data.size());
+        ::close(fd);
+      }
+      catch (...)
+      {
+        abandon(target);
+        throw;
+      }
+
+      commit(target.path, data);
+      return std::move(target.path);
+    }
+
+#if defined(BOOST_ASIO_HAS_FILE)
+    // Same as store(), but the write is submitted to the executor's io_uring instead of blocking the thread.
+    asio::awaitable<fs::path> asyncStore(std::string_view data, std::uint32_t sourceId = 0, std::uint64_t timestamp = 0)
+    {
+      auto target = prepare(sourceId, timestamp);
+
+      try
+      {
+        asio::stream_file file{ co_await asio::this_coro::executor };
+
+        // The descriptor is only owned by `file` once assigned.
+        const int fd = open(target);
+        boost::system::error_code ec;
+        file.assign(fd, ec);
+        if (ec)
+        {
+          ::close(fd);
+          throw boost::system::system_error{ ec };
+        }
+
+        co_await asio::async_write(file, asio::buffer(data), asio::use_awaitable);
+        finish(file.native_handle(), target, data.size());
+        file.close();
+      }
+      catch (...)
+      {
+        abandon(target);
+        throw;
+      }
+
+      commit(target.path, data);
+      co_return std::move(target.path);
+    }
+#endif
+
+    // Called with the path of every stored frame, on the thread that stored it.
+    // Has to be set before frames are stored.
+    void onStored(Observer observer) { _observer = std::move(observer); }
+
+    // Files derived from a frame (e.g. previews) are stored next to it as `<id><suffix>`. Registered suffixes are
+    // removed together with the frame.
+    static fs::path sidecar(const fs::path& frame, std::string_view suffix)
+    {
+      auto path = frame;
+      path.replace_extension(suffix);
+      return path;
+    }
+
+    // Has to be called before frames are stored.
+    void addSidecar(std::string suffix) { _sidecars.push_back(std::move(suffix)); }
+
+    const fs::path& directory() const noexcept { return _storageDir; }
+
+  private:
+    static constexpr std::uint64_t IdBlock = 4096;
+
+    struct Shard
+    {
+      std::int64_t hour = -1;
+      fs::path path;
+    };
+
+    std::uint64_t nextId()
+    {
+      if (_nextId == _reservedId)
+      {
+        reserveIds(_nextId + IdBlock);
+      }
+
+      return _nextId++;
+    }
+
+    // Persists the end of the reserved ID block, a crash skips at most the rest of the block.
+    void reserveIds(std::uint64_t reserved)
+    {
+      const auto file = _storageDir / ".nextid";
+      const auto temp = _storageDir / ".nextid.tmp";
+
+      {
+        std::ofstream out{ temp, std::ios::trunc };
+        out << reserved;
+        if (!out.flush())
+        {
+          throw std::runtime_error("Can't reserve frame IDs");
+        }
+      }
+
+      fs::rename(temp, file);
+      _reservedId = reserved;
+    }
+
+    void recover()
+    {
+      std::uint64_t reserved = 0;
+      if (std::ifstream in{ _storageDir / ".nextid" }; in.is_open())
+      {
+        in >> reserved;
+      }
+
+      std::vector<std::pair<std::uint64_t, fs::path>> frames;
+      std::vector<std::pair<std::uint64_t, fs::path>> sidecars;
+      for (auto it = fs::recursive_directory_iterator{ _storageDir }; it != fs::recursive_directory_iterator{}; ++it)
+      {
+        const auto& entry = *it;
+
+        // Hidden directories hold state next to the frames (partial uploads), not frames.
+        if (entry.is_directory() && entry.path().filename().native().starts_with('.'))
+        {
+          it.disable_recursion_pending();
+          continue;
+        }
+
+        if (!entry.is_regular_file())
+        {
+          continue;
+        }
+
+        // Frames are named `<id>.jpg`, their sidecars `<id>.<suffix>`.
+        const auto name = entry.path().filename().native();
+
+        std::uint64_t id;
+        const auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), id);
+        if (error != std::errc{} || end == name.data() + name.size() || *end != '.')
+        {
+          continue;
+        }
+
+        if (std::string_view{ end } == ".jpg")
+        {
+          frames.emplace_back(id, entry.path());
+        }
+        else
+        {
+          sidecars.emplace_back(id, entry.path());
+        }
+      }
+
+      std::sort(frames.begin(), frames.end());
+
+      _nextId     = std::max(reserved, frames.empty() ? 0 : frames.back().first + 1);
+      _reservedId = _nextId;
+
+      if (_retention != 0)
+      {
+        // Trim frames left over from a run with a larger limit, together with sidecars that outlived their frame.
+        const auto trimmed = frames.size() > _retention ? frames.size() - _retention : 0;
+        for (std::size_t i = 0; i < frames.size(); ++i)
+        {
+          if (i < trimmed)
+          {
+            removeFrame(frames[i].second);
+          }
+          else
+          {
+            _frames.push_back(std::move(frames[i].second));
+          }
+        }
+
+        const auto oldest = frames.size() > trimmed ? frames[trimmed].first : _nextId;
+        for (const auto& [id, path] : sidecars)
+        {
+          if (id < oldest)
+          {
+            std::error_code ec;
+            fs::remove(path, ec);
+            removeEmptyShards(path.parent_path());
+          }
+        }
+      }
+    }
+
+    const fs::path& shardOf(std::uint32_t sourceId, std::uint64_t timestamp)
+    {
+      const auto seconds = timestamp != 0
+                               ? static_cast<std::time_t>(timestamp / 1'000'000)
+                               : std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+      // Shards change at most once per hour and source, only touch the file system when they do.
+      auto& shard     = _shards[sourceId];
+      const auto hour = seconds / 3600;
+      if (hour != shard.hour)
+      {
+        std::tm tm{};
+        gmtime_r(&seconds, &tm);
+
+        shard.path = fs::path{ fmt::format("src{}", sourceId) }
+                     / fmt::format("{:04}-{:02}-{:02}", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday)
+                     / fmt::format("{:02}", tm.tm_hour);
+        shard.hour = hour;
+
+        fs::create_directories(_storageDir / shard.path);
+      }
+
+      return shard.path;
+    }
+
+    // Returns false if the new frame needs a new file.
+    bool recycle(const fs::path& oldest, const fs::path& path)
+    {
+      removeSidecars(oldest);
+
+      std::error_code ec;
+      fs::rename(oldest, path, ec);
+      if (ec)
+      {
+        // The oldest frame was removed behind our back.
+        spdlog::warn("Can't recycle {}: {}", oldest.string(), ec.message());
+        return false;
+      }
+
+      removeEmptyShards(oldest.parent_path());
+      return true;
+    }
+
+    void removeFrame(const fs::path& path)
+    {
+      std::error_code ec;
+      fs::remove(path, ec);
+      removeSidecars(path);
+      removeEmptyShards(path.parent_path());
+    }
+
+    void removeSidecars(const fs::path& frame)
+    {
+      std::error_code ec;
+      for (const auto& suffix : _sidecars)
+      {
+        fs::remove(sidecar(frame, suffix), ec);
+      }
+    }
+
+    // Removes the hour and date directories once their last frame is gone.
+    void removeEmptyShards(const fs::path& hourDir)
+    {
+      std::error_code ec;
+      if (fs::remove(hourDir, ec))
+      {
+        fs::remove(hourDir.parent_path(), ec);
+
+        // The removed shard may still be the current one of a source.
+        std::erase_if(_shards, [&](const auto& shard) { return _storageDir / shard.second.path == hourDir; });
+      }
+    }
+
+    struct Target
+    {
+      fs::path path;
+      bool recycled;
+      bool owned = false;  // The file at `path` was created or recycled for this frame
+    };
+
+    Target prepare(std::uint32_t sourceId, std::uint64_t timestamp)
+    {
+      std::lock_guard lock{ _mutex };
+      Target target{ _storageDir / shardOf(sourceId, timestamp) / fmt::format("{:012}.jpg", nextId()), false };
+
+      // Frames being written count against the limit, so concurrent writers can't push the ring past it.
+      if (_retention != 0 && !_frames.empty() && _frames.size() + _writing >= _retention)
+      {
+        target.recycled = recycle(_frames.front(), target.path);
+        target.owned    = target.recycled;
+        _frames.pop_front();
+      }
+
+      ++_writing;
+      return target;
+    }
+
+    void commit(const fs::path& path, std::string_view data)
+    {
+      {
+        std::lock_guard lock{ _mutex };
+        --_writing;
+        if (_retention != 0)
+        {
+          _frames.push_back(path);
+        }
+      }
+
+      if (_observer)
+      {
+        _observer(path, data);
+      }
+    }
+
+    // The frame never joins the ring, its file would be left behind until the next start. A file that was already
+    // there (open() failed with EEXIST) isn't this frame's to remove.
+    void abandon(const Target& target)
+    {
+      std::lock_guard lock{ _mutex };
+      --_writing;
+      if (target.owned)
+      {
+        removeFrame(target.path);
+      }
+    }
+
+    int open(Target& target)
+    {
+      const int createFlags = target.recycled ? 0 : O_CREAT | O_EXCL;
+      const int fd          = ::open(target.path.c_str(), O_WRONLY | O_CLOEXEC | createFlags, 0644);
+      if (fd < 0)
+      {
+        throw std::system_error{ errno, std::generic_category(), "Can't open file for writing" };
+      }
+
+      target.owned = true;
+
+      if (!target.recycled && _preallocate != 0)
+      {
+        // Best effort, not every file system supports it.
+        ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(_preallocate));
+      }
+
+      return fd;
+    }
+
+    // A recycled file may be longer than the new frame. Truncating releases the blocks past the new size, so the
+    // reservation is topped up again; blocks that are still allocated are not touched. Without retention a file is
+    // never recycled, its reservation is released for good.
+    void finish(int fd, const Target& target, std::size_t size)
+    {
+      if (target.recycled)
+      {
+        ::ftruncate(fd, static_cast<off_t>(size));
+        if (_preallocate != 0)
+        {
+          ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(_preallocate));
+        }
+      }
+      else if (_retention == 0 && _preallocate != 0)
+      {
+        ::ftruncate(fd, static_cast<off_t>(size));
+      }
+    }
+
+    fs::path _storageDir;
+    std::size_t _retention;
+    std::size_t _preallocate;
+    std::uint64_t _nextId     = 0;
+    std::uint64_t _reservedId = 0;
+    std::deque<fs::path> _frames;
+    std::size_t _writing = 0;  // Frames between prepare() and commit()
+    std::unordered_map<std::uint32_t, Shard> _shards;
+    std::vector<std::string> _sidecars;
+    Observer _observer;
+    std::mutex _mutex;
+  };
+}  // namespace net
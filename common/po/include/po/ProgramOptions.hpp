@@ -5,6 +5,7 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace fs       = std::filesystem;
 namespace boost_po = boost::program_options;
@@ -12,12 +13,27 @@ using namespace std::chrono_literals;
 
 namespace po
 {
+    inline auto nonNegative(const char* option)
+    {
+        return [option](std::int64_t value)
+        {
+            if (value < 0)
+            {
+                throw boost_po::validation_error{ boost_po::validation_error::invalid_option_value, option };
+            }
+        };
+    }
+
     struct CommonOptions
     {
         std::string serverIp;
         std::uint16_t serverPort;
         fs::path outDir;
         std::int64_t timeout;
+        fs::path logFile;
+        fs::path traceFile;
+        fs::path unixPath;
+        fs::path shmPath;
 
         void addOptions(boost_po::options_description& description)
         {
@@ -26,7 +42,11 @@ namespace po
             ("ip", boost_po::value<std::string>(&serverIp)->default_value("127.0.0.1"), "Server IP address")
             ("port,p", boost_po::value<std::uint16_t>(&serverPort)->required(), "Server port")
             ("outdir", boost_po::value<fs::path>(&outDir)->required(), "Output directory")
-            ("timeout", boost_po::value<std::int64_t>(&timeout)->default_value(30), "Connection timeout");
+            ("timeout", boost_po::value<std::int64_t>(&timeout)->default_value(30), "Connection timeout")
+            ("logfile", boost_po::value<fs::path>(&logFile), "Log file (stderr if not set)")
+            ("trace", boost_po::value<fs::path>(&traceFile), "Write a Chrome trace-event JSON file on exit")
+            ("unix", boost_po::value<fs::path>(&unixPath), "Unix domain socket for the binary protocol (same host only)")
+            ("shm", boost_po::value<fs::path>(&shmPath), "Unix domain socket for the shared memory transport (same host only)");
             // clang-format on
         }
     };
@@ -35,6 +55,13 @@ namespace po
     {
         fs::path videoDevice;
         std::int64_t recTime;
+        std::size_t burstCount;
+        std::int64_t burstInterval;
+        std::uint32_t sourceId;
+        bool binary;
+        bool stream;
+        fs::path spoolDir;
+        double catchUpRate;
 
         void addOptions(boost_po::options_description& description)
         {
@@ -42,14 +69,54 @@ namespace po
             // clang-format off
             description.add_options()
             ("videodevice", boost_po::value<fs::path>(&videoDevice)->default_value("/dev/video0"), "Video Device")
-            ("rectime", boost_po::value<std::int64_t>(&recTime)->default_value(10), "Recording time");
+            ("rectime", boost_po::value<std::int64_t>(&recTime)->default_value(10), "Recording time")
+            ("burst", boost_po::value<std::size_t>(&burstCount)->default_value(0), "Frames per burst (0 for single shots)")
+            ("burstinterval", boost_po::value<std::int64_t>(&burstInterval)->default_value(0)->notifier(nonNegative("burstinterval")), "Minimal interval between burst frames [ms]")
+            ("sourceid", boost_po::value<std::uint32_t>(&sourceId)->default_value(0), "Source (camera) ID sent with every frame")
+            ("binary", boost_po::bool_switch(&binary), "Upload with the binary framing protocol instead of HTTP")
+            ("stream", boost_po::bool_switch(&stream), "Encode in-process and upload each frame with chunked HTTP while it is encoded")
+            ("spool", boost_po::value<fs::path>(&spoolDir), "Keep pending frames in a spool directory and upload them resumably (HTTP only)")
+            ("catchuprate", boost_po::value<double>(&catchUpRate)->default_value(0), "Upload rate while draining a spooled backlog [MiB/s] (0 for unlimited)");
             // clang-format on
         }
     };
 
     struct ServerOptions : CommonOptions
     {
-        void addOptions(boost_po::options_description& description) { CommonOptions::addOptions(description); }
+        std::uint16_t binaryPort;
+        std::size_t threads;
+        std::size_t retention;
+        std::size_t preallocate;
+        std::vector<std::string> stages;
+        std::size_t processThreads;
+        std::string upstream;
+        std::size_t upstreamConnections;
+        std::size_t upstreamQueue;
+        bool relayStore;
+        fs::path captureFile;
+        bool captureBodies;
+        unsigned uiFps;
+
+        void addOptions(boost_po::options_description& description)
+        {
+            CommonOptions::addOptions(description);
+            // clang-format off
+            description.add_options()
+            ("binport", boost_po::value<std::uint16_t>(&binaryPort)->default_value(0), "Binary framing protocol port (0 to disable)")
+            ("threads", boost_po::value<std::size_t>(&threads)->default_value(0), "Network threads, each with its own endpoints (0 for one per core)")
+            ("retention", boost_po::value<std::size_t>(&retention)->default_value(0), "Number of stored frames to keep (0 keeps all)")
+            ("prealloc", boost_po::value<std::size_t>(&preallocate)->default_value(0), "Bytes preallocated per stored frame (0 to disable)")
+            ("process", boost_po::value<std::vector<std::string>>(&stages)->multitoken(), "Processing stages run on every frame (checksum, histogram, motion)")
+            ("processthreads", boost_po::value<std::size_t>(&processThreads)->default_value(2), "Processing worker threads")
+            ("upstream", boost_po::value<std::string>(&upstream), "Relay frames to the binary port of an upstream server (host:port)")
+            ("upstreamconnections", boost_po::value<std::size_t>(&upstreamConnections)->default_value(4), "Connections to the upstream server")
+            ("upstreamqueue", boost_po::value<std::size_t>(&upstreamQueue)->default_value(64), "Unacknowledged data per upstream connection before receiving waits [MiB]")
+            ("relaystore", boost_po::bool_switch(&relayStore), "Also store relayed frames locally")
+            ("capture", boost_po::value<fs::path>(&captureFile), "Record arrival time, size and source of every frame to a capture file")
+            ("capturebodies", boost_po::bool_switch(&captureBodies), "Also record the frames themselves in the capture file")
+            ("uifps", boost_po::value<unsigned>(&uiFps)->default_value(10), "Refresh rate cap of the camera grid in the UI");
+            // clang-format on
+        }
     };
 
     inline bool parse(int argc, char* argv[], auto& opts)
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "exe/Trace.hpp"
+#include "img/Jpeg.hpp"
+#include "logging/Logging.hpp"
+#include "net/Ingest.hpp"
+
+namespace
+{
+  namespace asio = boost::asio;
+}  // namespace
+
+namespace proc
+{
+  inline constexpr std::string_view MetadataSuffix = ".meta.json";
+
+  // What a stage gets to see of a frame. The thumbnail is decoded on first use and shared by all stages.
+  struct Context
+  {
+    explicit Context(const net::Frame& frame) : frame{ frame } { }
+
+    // Smallest DCT-scaled (1/8) decode of the frame, enough for statistics.
+    const img::Image& thumbnail()
+    {
+      if (!_thumbnail)
+      {
+        _thumbnail = img::decodeScaled(frame.data, 1, 1);
+      }
+
+      return *_thumbnail;
+    }
+
+    const net::Frame& frame;
+
+  private:
+    std::optional<img::Image> _thumbnail;
+  };
+
+  // A named processing step. `run` returns its result as a JSON value and is called on a worker
+  // thread, possibly for several frames at once.
+  struct Stage
+  {
+    std::string name;
+    std::function<std::string(Context&)> run;
+  };
+
+  using Factory = std::function<Stage()>;
+
+  inline std::map<std::string, Factory, std::less<>>& registry()
+  {
+    static std::map<std::string, Factory, std::less<>> factories;
+    return factories;
+  }
+
+  // Returns a value so that it can initialize a namespace scope variable, see Stages.hpp.
+  inline bool registerStage(std::string name, Factory factory)
+  {
+    return registry().emplace(std::move(name), std::move(factory)).second;
+  }
+
+  inline Stage makeStage(std::string_view name)
+  {
+    auto it = registry().find(name);
+    if (it == registry().end())
+    {
+      throw std::runtime_error(fmt::format("Unknown processing stage '{}'", name));
+    }
+
+    return it->second();
+  }
+
+  // Runs the stages on a thread pool once a frame has been stored and writes their results next to
+  // it as `<id>.meta.json`. Sessions await the result, so a slow stage delays the acknowledgement of
+  // its own connection only; once `maxQueue` frames are in flight, further frames skip processing.
+  struct Processor
+  {
+    Processor(std::size_t threads, std::vector<Stage> stages, std::size_t maxQueue = 32)
+        : _pool{ threads }, _stages{ std::move(stages) }, _maxQueue{ maxQueue }, _traceId{ exe::trace::newId() }
+    {
+    }
+
+    ~Processor() { _pool.join(); }
+
+    // May be called from the executors of several network threads.
+    asio::awaitable<void> process(const net::Frame& frame)
+    {
+      if (_pending.fetch_add(1, std::memory_order_relaxed) >= _maxQueue)
+      {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Processing queue is full, skipping frames");
+        co_return;
+      }
+
+      try
+      {
+        co_await asio::co_spawn(_pool, run(frame), asio::use_awaitable);
+      }
+      catch (const std::exception& ex)
+      {
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Processing of {} failed: {}", frame.path.string(), ex.what());
+      }
+
+      _pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+  private:
+    asio::awaitable<void> run(const net::Frame& frame)
+    {
+      exe::trace::Span span{ "process_frame", _traceId, frame.sequence };
+
+      Context context{ frame };
+      std::string results;
+      for (const auto& stage : _stages)
+      {
+        std::string value;
+        try
+        {
+          value = stage.run(context);
+        }
+        catch (const std::exception& ex)
+        {
+          LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 5 }, "Stage {} failed: {}", stage.name, ex.what());
+          value = "null";
+        }
+
+        results += fmt::format("{}\"{}\":{}", results.empty() ? "" : ",", stage.name, value);
+      }
+
+      std::ofstream file{ net::Storage::sidecar(frame.path, MetadataSuffix) };
+      file << fmt::format(R"({{"source":{},"sequence":{},"timestamp":{},"size":{},"stages":{{{}}}}})",
+                          frame.sourceId,
+                          frame.sequence,
+                          frame.timestamp,
+                          frame.data.size(),
+                          results)
+           << '\n';
+
+      co_return;
+    }
+
+    asio::thread_pool _pool;
+    std::vector<Stage> _stages;
+    std::size_t _maxQueue;
+    std::atomic<std::size_t> _pending = 0;
+    std::uint64_t _traceId;
+  };
+}  // namespace proc
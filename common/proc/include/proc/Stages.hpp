@@ -0,0 +1,110 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <array>
+#include <boost/crc.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "proc/Processor.hpp"
+
+namespace proc
+{
+  // Built-in stages, available by name through makeStage().
+  namespace stages
+  {
+    inline std::uint8_t luma(const unsigned char* rgb) noexcept
+    {
+      return static_cast<std::uint8_t>((77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2]) >> 8);
+    }
+
+    // CRC-32 of the stored bytes.
+    inline Stage checksum()
+    {
+      return { "checksum",
+               [](Context& context)
+               {
+                 boost::crc_32_type crc;
+                 crc.process_bytes(context.frame.data.data(), context.frame.data.size());
+                 return fmt::format("\"{:08x}\"", crc.checksum());
+               } };
+    }
+
+    // 16 bin luma histogram of the thumbnail, in per mille of its pixels.
+    inline Stage histogram()
+    {
+      return { "histogram",
+               [](Context& context)
+               {
+                 const auto& image = context.thumbnail();
+
+                 std::array<std::size_t, 16> bins{};
+                 for (std::size_t i = 0; i < image.rgb.size(); i += 3)
+                 {
+                   ++bins[luma(&image.rgb[i]) >> 4];
+                 }
+
+                 const auto pixels = std::max<std::size_t>(image.rgb.size() / 3, 1);
+                 std::array<std::size_t, 16> perMille;
+                 for (std::size_t i = 0; i < bins.size(); ++i)
+                 {
+                   perMille[i] = bins[i] * 1000 / pixels;
+                 }
+
+                 return fmt::format("[{}]", fmt::join(perMille, ","));
+               } };
+    }
+
+    // Mean absolute luma difference to the previous frame of the same source (0-255), frames scoring
+    // above `threshold` are flagged as moving.
+    inline Stage motion(unsigned threshold = 12)
+    {
+      struct State
+      {
+        std::mutex mutex;
+        std::unordered_map<std::uint32_t, std::vector<std::uint8_t>> previous;
+      };
+
+      return { "motion",
+               [threshold, state = std::make_shared<State>()](Context& context)
+               {
+                 const auto& image = context.thumbnail();
+
+                 std::vector<std::uint8_t> current(image.rgb.size() / 3);
+                 for (std::size_t i = 0; i < current.size(); ++i)
+                 {
+                   current[i] = luma(&image.rgb[i * 3]);
+                 }
+
+                 std::vector<std::uint8_t> previous;
+                 {
+                   std::lock_guard lock{ state->mutex };
+                   previous = std::exchange(state->previous[context.frame.sourceId], current);
+                 }
+
+                 if (previous.size() != current.size() || current.empty())
+                 {
+                   return std::string{ "null" };
+                 }
+
+                 std::uint64_t difference = 0;
+                 for (std::size_t i = 0; i < current.size(); ++i)
+                 {
+                   difference += static_cast<std::uint64_t>(std::abs(current[i] - previous[i]));
+                 }
+
+                 const auto score = static_cast<double>(difference) / static_cast<double>(current.size());
+                 return fmt::format(R"({{"score":{:.2f},"moving":{}}})", score, score > threshold);
+               } };
+    }
+  }  // namespace stages
+
+  inline const bool builtinStagesRegistered = registerStage("checksum", [] { return stages::checksum(); })
+                                              && registerStage("histogram", [] { return stages::histogram(); })
+                                              && registerStage("motion", [] { return stages::motion(); });
+}  // namespace proc
@@ -0,0 +1,315 @@
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "exe/Exe.hpp"
+#include "logging/Logging.hpp"
+#include "net/Capture.hpp"
+#include "net/ClientEndpoint.hpp"
+#include "net/FrameClientEndpoint.hpp"
+#include "po/ProgramOptions.hpp"
+
+// Re-drives a server with the traffic recorded by `server --capture`: frames are sent with their recorded sizes, source
+// IDs and (scaled) arrival times over a pool of connections, and throughput and latency percentiles are reported.
+// Latency is measured from the moment a frame was due, so frames that wait for a free connection count as late.
+
+namespace
+{
+  namespace asio = boost::asio;
+  namespace fs   = std::filesystem;
+  using Clock    = std::chrono::steady_clock;
+
+  struct ReplayOptions
+  {
+    fs::path capture;
+    std::string serverIp;
+    std::uint16_t serverPort;
+    bool binary;
+    double speed;
+    std::size_t connections;
+    std::int64_t timeout;
+
+    void addOptions(boost_po::options_description& description)
+    {
+      // clang-format off
+      description.add_options()
+      ("capture", boost_po::value<fs::path>(&capture)->required(), "Capture file written by the server")
+      ("ip", boost_po::value<std::string>(&serverIp)->default_value("127.0.0.1"), "Server IP address")
+      ("port,p", boost_po::value<std::uint16_t>(&serverPort)->required(), "Server port (binary port with --binary)")
+      ("binary", boost_po::bool_switch(&binary), "Use the binary framing protocol instead of HTTP")
+      ("speed", boost_po::value<double>(&speed)->default_value(1.0), "Replay speed relative to the capture (0 for as fast as possible)")
+      ("connections", boost_po::value<std::size_t>(&connections)->default_value(16), "Concurrent connections")
+      ("timeout", boost_po::value<std::int64_t>(&timeout)->default_value(30), "Connection timeout");
+      // clang-format on
+    }
+  };
+
+  struct Due
+  {
+    std::size_t record;
+    Clock::time_point at;
+  };
+
+  // Frames that are due, handed from the scheduler to the connections. Everything runs on one thread.
+  struct Schedule
+  {
+    explicit Schedule(const exe::Executor auto& executor) : _signal{ executor, Clock::time_point::max() } { }
+
+    void push(Due due)
+    {
+      _due.push_back(due);
+      _signal.cancel();
+    }
+
+    void close()
+    {
+      _closed = true;
+      _signal.cancel();
+    }
+
+    asio::awaitable<std::optional<Due>> pop()
+    {
+      while (_due.empty() && !_closed)
+      {
+        co_await _signal.async_wait();
+      }
+
+      if (_due.empty())
+      {
+        co_return std::nullopt;
+      }
+
+      auto due = _due.front();
+      _due.pop_front();
+      co_return due;
+    }
+
+  private:
+    Timer _signal;
+    std::deque<Due> _due;
+    bool _closed = false;
+  };
+
+  struct Results
+  {
+    std::vector<double> latencies;
+    std::size_t failed = 0;
+    std::uint64_t bytes = 0;
+  };
+
+  // Captures without bodies are replayed with filler of the recorded size. It is generated once, for the largest
+  // record, so that a replay at full speed measures the server and not the generator.
+  std::string makeFiller(const net::capture::Reader& reader)
+  {
+    if (reader.hasBodies())
+    {
+      return {};
+    }
+
+    std::uint32_t longest = 0;
+    for (const auto& record : reader.records())
+    {
+      longest = std::max(longest, record.length);
+    }
+
+    std::mt19937 random{ 42 };
+    std::string filler(longest, '\0');
+    std::generate(filler.begin(), filler.end(), [&random] { return static_cast<char>(random()); });
+    return filler;
+  }
+
+  std::string frameData(net::capture::Reader& reader, const net::capture::Record& record, std::string_view filler)
+  {
+    if (reader.hasBodies())
+    {
+      return reader.body(record);
+    }
+
+    return std::string{ filler.substr(0, record.length) };
+  }
+
+  asio::awaitable<void> schedule(Schedule& due, const net::capture::Reader& reader, double speed)
+  {
+    auto executor = co_await asio::this_coro::executor;
+    Timer timer{ executor };
+
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < reader.records().size(); ++i)
+    {
+      // At full speed a frame is due when a connection picks it up.
+      Clock::time_point at;
+      if (speed > 0)
+      {
+        at = start + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double, std::micro>(static_cast<double>(reader.records()[i].offset) / speed));
+        timer.expires_at(at);
+        co_await timer.async_wait();
+      }
+
+      due.push({ i, at });
+    }
+
+    due.close();
+  }
+
+  template<typename Endpoint>
+  asio::awaitable<void> send(Endpoint& endpoint, std::string data, std::uint32_t sourceId)
+  {
+    if constexpr (std::is_same_v<Endpoint, net::ClientEndpoint>)
+    {
+      co_await endpoint.sendData(std::move(data), sourceId);
+    }
+    else
+    {
+      co_await endpoint.send(data, sourceId);
+    }
+  }
+
+  // Endpoints can't be moved, their deadlines refer to them.
+  template<typename Endpoint>
+  Endpoint makeEndpoint(const exe::Executor auto& executor, const ReplayOptions& opts)
+  {
+    const auto port = std::to_string(opts.serverPort);
+    if constexpr (std::is_same_v<Endpoint, net::ClientEndpoint>)
+    {
+      return Endpoint{ executor, opts.serverIp, port, opts.timeout };
+    }
+    else
+    {
+      // A window of one, so that every send waits for its ack.
+      return Endpoint{ executor, opts.serverIp, port, opts.timeout, 0, 1 };
+    }
+  }
+
+  template<typename Endpoint>
+  asio::awaitable<void> connection(const ReplayOptions& opts,
+                                   Schedule& due,
+                                   net::capture::Reader& reader,
+                                   std::string_view filler,
+                                   Results& results)
+  {
+    auto endpoint = makeEndpoint<Endpoint>(co_await asio::this_coro::executor, opts);
+
+    while (auto next = co_await due.pop())
+    {
+      const auto& record = reader.records()[next->record];
+      const auto dueAt   = next->at != Clock::time_point{} ? next->at : Clock::now();
+
+      try
+      {
+        co_await send(endpoint, frameData(reader, record, filler), record.sourceId);
+        results.latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - dueAt).count());
+        results.bytes += record.length;
+      }
+      catch (const std::exception& ex)
+      {
+        ++results.failed;
+        LOG_WARN_RATE_LIMITED(std::chrono::seconds{ 1 }, "Sending frame {} failed: {}", next->record, ex.what());
+      }
+    }
+  }
+
+  double percentile(const std::vector<double>& sorted, double p)
+  {
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())))];
+  }
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  ReplayOptions opts;
+  if (!po::parse(argc, argv, opts))
+  {
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    net::capture::Reader reader{ opts.capture };
+    if (reader.records().empty())
+    {
+      fmt::print(stderr, "Capture is empty\n");
+      return EXIT_FAILURE;
+    }
+
+    const auto duration = static_cast<double>(reader.records().back().offset) / 1e6;
+    fmt::print("capture:            {} frames over {:.1f} s{}\n",
+               reader.records().size(),
+               duration,
+               reader.hasBodies() ? "" : ", without bodies (sending filler)");
+
+    // ClientEndpoint prints every response.
+    std::ostringstream discard;
+    auto* coutBuffer = std::cout.rdbuf(discard.rdbuf());
+
+    const auto filler = makeFiller(reader);
+
+    asio::io_context io;
+    Schedule due{ io.get_executor() };
+    Results results;
+    results.latencies.reserve(reader.records().size());
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(opts.connections, 1); ++i)
+    {
+      if (opts.binary)
+      {
+        exe::submit(io.get_executor(), connection<net::FrameClientEndpoint>(opts, due, reader, filler, results));
+      }
+      else
+      {
+        exe::submit(io.get_executor(), connection<net::ClientEndpoint>(opts, due, reader, filler, results));
+      }
+    }
+
+    const auto start = Clock::now();
+    exe::submit(io.get_executor(), schedule(due, reader, opts.speed));
+    io.run();
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout.rdbuf(coutBuffer);
+
+    auto& latencies = results.latencies;
+    if (latencies.empty())
+    {
+      fmt::print(stderr, "No frame was sent\n");
+      return EXIT_FAILURE;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto sent = static_cast<double>(latencies.size());
+
+    fmt::print("speed:              {}\n", opts.speed > 0 ? fmt::format("{}x", opts.speed) : std::string{ "max" });
+    fmt::print("protocol:           {}, {} connections\n", opts.binary ? "binary" : "http", opts.connections);
+    fmt::print("frames:             {} sent, {} failed\n", latencies.size(), results.failed);
+    fmt::print("elapsed:            {:.1f} s\n", elapsed);
+    fmt::print("throughput:         {:.1f} frames/s, {:.1f} MiB/s\n",
+               sent / elapsed,
+               static_cast<double>(results.bytes) / elapsed / (1024 * 1024));
+    fmt::print("latency [us]:       p50 {:.0f}, p90 {:.0f}, p99 {:.0f}, p99.9 {:.0f}, max {:.0f}\n",
+               percentile(latencies, 0.5),
+               percentile(latencies, 0.9),
+               percentile(latencies, 0.99),
+               percentile(latencies, 0.999),
+               latencies.back());
+  }
+  catch (const std::exception& ex)
+  {
+    fmt::print(stderr, "{}\n", ex.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,43 +1,177 @@
-#include "dir/Monitor.hpp"
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include "exe/Exe.hpp"
+#include "logging/Logging.hpp"
+#include "net/Capture.hpp"
+#include "net/FrameServerEndpoint.hpp"
 #include "net/ServerEndpoint.hpp"
+#include "net/ShmServerEndpoint.hpp"
+#include "net/Ingest.hpp"
+#include "net/PartialUploads.hpp"
+#include "net/Relay.hpp"
+#include "net/Storage.hpp"
 #include "po/ProgramOptions.hpp"
+#include "proc/Stages.hpp"
+
+#if !defined(CAMERA_ASIO_HEADLESS)
 #include "ui/ServerWindow.hpp"
+#endif
 
 namespace asio = boost::asio;
 using namespace std::chrono_literals;
 
-asio::awaitable<void> updateUI(ui::ServerWindow& window, po::ServerOptions& opts)
+// Shared by all network threads. Everything else (endpoints, ingest) exists once per thread.
+struct Services
 {
-  auto executor = co_await asio::this_coro::executor;
-  auto state    = co_await asio::this_coro::cancellation_state;
+  // The relay runs on a thread of its own, so that all network threads share its upstream connections. Declared
+  // first, the context outlives the relay.
+  asio::io_context relayContext;
+  std::optional<net::Relay> relay;
+  std::optional<net::capture::Writer> capture;
+  std::optional<net::PartialUploads> partials;
+  std::optional<net::Storage> storage;
+  std::optional<proc::Processor> processor;
+#if !defined(CAMERA_ASIO_HEADLESS)
+  ui::ServerWindow* window = nullptr;
+#endif
+};
+
+template<typename Endpoint>
+asio::awaitable<void> listen(std::optional<Endpoint>& endpoint)
+{
+  if (endpoint)
+  {
+    co_await endpoint->doListen();
+  }
+}
+
+asio::awaitable<void> relay(std::optional<net::Relay>& relay)
+{
+  if (relay)
+  {
+    co_await relay->run();
+  }
+}
+
+#if !defined(CAMERA_ASIO_HEADLESS)
+// Only hands the frame over, the window decodes the latest frame per source at its own pace.
+asio::awaitable<void> show(ui::ServerWindow& window, const net::Frame& frame)
+{
+  window.asyncFrameUpdate(frame.sourceId, frame.data);
+  co_return;
+}
+#endif
 
-  dir::Monitor monitor{ executor, opts.outDir, IN_CLOSE_WRITE };
+void setUp(Services& services, const po::ServerOptions& opts)
+{
+  if (!opts.captureFile.empty())
+  {
+    services.capture.emplace(opts.captureFile, opts.captureBodies);
+  }
+
+  if (!opts.upstream.empty())
+  {
+    const auto colon = opts.upstream.rfind(':');
+    if (colon == std::string::npos)
+    {
+      throw std::runtime_error("--upstream has to be host:port");
+    }
+
+    services.relay.emplace(services.relayContext.get_executor(),
+                           opts.upstream.substr(0, colon),
+                           opts.upstream.substr(colon + 1),
+                           opts.upstreamConnections,
+                           opts.timeout,
+                           opts.upstreamQueue << 20);
+  }
 
-  while (true)
+  // A relay only keeps the frames it forwards when asked to. Partial uploads live next to the stored frames.
+  if (opts.upstream.empty() || opts.relayStore)
   {
-    fs::path imagePath = co_await monitor.getNewImage1();
-    if (!imagePath.empty())
+    services.storage.emplace(opts.outDir, opts.retention, opts.preallocate);
+    services.partials.emplace(opts.outDir / ".partial");
+  }
+
+  auto& storage = services.storage;
+  if (!opts.stages.empty())
+  {
+    if (!storage)
     {
-      window.asyncImageUpdate(std::move(imagePath));
+      throw std::runtime_error("Processing writes its results next to stored frames, add --relaystore");
     }
 
-    if (state.cancelled() != asio::cancellation_type::none)
+    std::vector<proc::Stage> stages;
+    for (const auto& name : opts.stages)
     {
-      spdlog::critical("Canceling updateUI coroutine...");
-      co_return;
+      stages.push_back(proc::makeStage(name));
     }
+
+    services.processor.emplace(opts.processThreads, std::move(stages));
+    storage->addSidecar(std::string{ proc::MetadataSuffix });
   }
 }
 
-asio::awaitable<void> receiveImages(po::ServerOptions& opts)
+// Runs on every network thread. TCP ports are shared by all threads (SO_REUSEPORT), the same-host
+// transports only run on the first one.
+asio::awaitable<void> receiveImages(Services& services, po::ServerOptions& opts, bool first)
 {
   auto executor = co_await asio::this_coro::executor;
   auto state    = co_await asio::this_coro::cancellation_state;
 
-  net::ServerEndpoint server{ executor, opts.outDir, opts.serverPort, opts.timeout };
+  net::Ingest ingest = services.storage ? net::Ingest{ *services.storage } : net::Ingest{};
+  if (services.capture)
+  {
+    ingest.captureTo(*services.capture);
+  }
 
-  co_await server.doListen();
+#if !defined(CAMERA_ASIO_HEADLESS)
+  // First, so that relay backpressure doesn't hold up the display.
+  if (services.window)
+  {
+    ingest.addStage([&services](const net::Frame& frame) { return show(*services.window, frame); });
+  }
+#endif
+
+  if (services.relay)
+  {
+    ingest.addStage([&services](const net::Frame& frame) { return services.relay->forward(frame); });
+  }
+
+  if (services.processor)
+  {
+    ingest.addStage([&services](const net::Frame& frame) { return services.processor->process(frame); });
+  }
+
+  const bool reusePort = opts.threads != 1;
+  net::ServerEndpoint server{ executor, ingest, opts.serverPort, opts.timeout, reusePort };
+  if (services.partials)
+  {
+    server.resumeWith(*services.partials);
+  }
+
+  std::optional<net::FrameServerEndpoint> frameServer;
+  if (opts.binaryPort != 0)
+  {
+    frameServer.emplace(executor, ingest, tcp::endpoint{ tcp::v4(), opts.binaryPort }, opts.timeout, reusePort);
+  }
+
+  std::optional<net::LocalFrameServerEndpoint> localServer;
+  if (first && !opts.unixPath.empty())
+  {
+    localServer.emplace(executor, ingest, local::endpoint{ opts.unixPath.string() }, opts.timeout);
+  }
+
+  std::optional<net::ShmServerEndpoint> shmServer;
+  if (first && !opts.shmPath.empty())
+  {
+    shmServer.emplace(executor, ingest, opts.shmPath);
+  }
+
+  co_await exe::whenAll(
+      server.doListen(), listen(frameServer), listen(localServer), listen(shmServer));
 
   if (state.cancelled() != asio::cancellation_type::none)
   {
@@ -47,14 +181,20 @@ asio::awaitable<void> receiveImages(po::ServerOptions& opts)
   co_return;
 }
 
-asio::awaitable<void> asyncMain(ui::ServerWindow& window, po::ServerOptions& opts)
+#if defined(CAMERA_ASIO_HEADLESS)
+asio::awaitable<void> asyncMain(Services& services, po::ServerOptions& opts, bool first)
+#else
+asio::awaitable<void> asyncMain(Services& services, po::ServerOptions& opts, bool first, ui::ServerWindow& window)
+#endif
 {
   spdlog::info("Starting async Main...");
 
   try
   {
-    co_await exe::whenAll(receiveImages(opts), updateUI(window, opts));
+    co_await receiveImages(services, opts, first);
+#if !defined(CAMERA_ASIO_HEADLESS)
     window.requestQuit();
+#endif
   }
   catch (const std::exception& ex)
   {
@@ -76,23 +216,75 @@ int main(int argc, char* argv[])
       return EXIT_FAILURE;
     }
 
+    logging::init(options.logFile);
+    if (!options.traceFile.empty())
+    {
+      exe::trace::enable();
+    }
+
+#if !defined(CAMERA_ASIO_HEADLESS)
     QApplication ui(argc, argv);
-    ui::ServerWindow window;
+    ui::ServerWindow window{ options.uiFps };
+#endif
 
-    asio::io_context io;
+    Services services;
+#if !defined(CAMERA_ASIO_HEADLESS)
+    services.window = &window;
+#endif
+    setUp(services, options);
 
-    exe::whenOneOf(io, asyncMain(window, options), exe::stopOnSignals(SIGINT));
+    // One io_context per thread, so that endpoints, timer wheels and buffer pools stay single-threaded.
+    const auto threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<asio::io_context> contexts(threads);
+    for (std::size_t i = 0; i < contexts.size(); ++i)
+    {
+#if defined(CAMERA_ASIO_HEADLESS)
+      exe::whenOneOf(contexts[i], asyncMain(services, options, i == 0), exe::stopOnSignals(SIGINT));
+#else
+      exe::whenOneOf(contexts[i], asyncMain(services, options, i == 0, window), exe::stopOnSignals(SIGINT));
+#endif
+    }
 
-    std::jthread t{ [&]() { io.run(); } };
+    std::vector<std::jthread> workers;
+    for (auto& io : contexts)
+    {
+      workers.emplace_back([&io]() { io.run(); });
+    }
 
+    // Kept running until the network threads are done, frames of sessions that are still closing find the relay
+    // stopped instead of waiting for it forever.
+    std::jthread relayWorker;
+    auto relayWork = asio::make_work_guard(services.relayContext);
+    if (services.relay)
+    {
+      exe::whenOneOf(services.relayContext, relay(services.relay), exe::stopOnSignals(SIGINT));
+      relayWorker = std::jthread{ [&services]() { services.relayContext.run(); } };
+    }
+
+#if !defined(CAMERA_ASIO_HEADLESS)
     window.show();
     ui.exec();
+#endif
+
+    workers.clear();
+    relayWork.reset();
+    if (relayWorker.joinable())
+    {
+      relayWorker.join();
+    }
+
+    if (!options.traceFile.empty())
+    {
+      exe::trace::exportChromeJson(options.traceFile);
+    }
   }
   catch (const std::exception& e)
   {
     spdlog::error("{}", e.what());
+    logging::shutdown();
     return EXIT_FAILURE;
   }
 
+  logging::shutdown();
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
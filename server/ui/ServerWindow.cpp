@@ -1,27 +1,135 @@
 #include "ServerWindow.hpp"
 
+#include <QPaintEvent>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+#include <spdlog/spdlog.h>
+
 namespace ui
 {
 
-    ServerWindow::ServerWindow(QWidget* parent) : QLabel{parent}
+    ServerWindow::ServerWindow(unsigned maxFps, QWidget* parent) : QWidget{parent}
     {
         resize(1280, 720);
-        connect(this, &ServerWindow::requestUpdate, &ServerWindow::updateImage);
+
+        // Tiles cover the whole window, nothing underneath has to be painted first.
+        setAttribute(Qt::WA_OpaquePaintEvent);
+
         connect(this, &ServerWindow::requestQuit, qApp, &QApplication::quit);
+        connect(&_refresh, &QTimer::timeout, this, &ServerWindow::refresh);
+        _refresh.start(1000 / static_cast<int>(std::max(maxFps, 1u)));
     }
 
     ServerWindow::~ServerWindow() { }
 
-    void ServerWindow::asyncImageUpdate(const std::filesystem::path& imagePath) { emit requestUpdate(imagePath); }
+    // Called from the network threads, a newer frame of the same source replaces one that wasn't shown yet.
+    void ServerWindow::asyncFrameUpdate(std::uint32_t sourceId, std::string_view jpeg)
+    {
+        std::lock_guard lock{_mutex};
+        _latest[sourceId].assign(jpeg);
+    }
 
     void ServerWindow::cancel() { printf("cancel\n"); emit requestQuit(); }
-    void ServerWindow::updateImage(const std::filesystem::path& imagePath)
+
+    void ServerWindow::refresh()
+    {
+        std::map<std::uint32_t, std::string> latest;
+        {
+            std::lock_guard lock{_mutex};
+            latest.swap(_latest);
+        }
+
+        bool added = false;
+        for (const auto& [sourceId, jpeg] : latest)
+        {
+            added |= _tiles.try_emplace(sourceId).second;
+        }
+
+        if (added)
+        {
+            layoutTiles();
+        }
+
+        for (const auto& [sourceId, jpeg] : latest)
+        {
+            auto& tile = _tiles[sourceId];
+            try
+            {
+                // Scaled in the DCT domain, a tile of a 16 camera grid decodes a fraction of the pixels.
+                tile.frame = img::decodeScaled(jpeg,
+                                               static_cast<unsigned>(std::max(tile.rect.width(), 1)),
+                                               static_cast<unsigned>(std::max(tile.rect.height(), 1)));
+                update(tile.rect);
+            }
+            catch (const std::exception& ex)
+            {
+                spdlog::warn("Can't show frame of source {}: {}", sourceId, ex.what());
+            }
+        }
+    }
+
+    // Near-square grid in source ID order. Frames decoded for the previous layout are scaled until the next arrives.
+    void ServerWindow::layoutTiles()
     {
-        QPixmap image(imagePath.c_str());
+        if (_tiles.empty())
+        {
+            return;
+        }
+
+        const auto count   = static_cast<int>(_tiles.size());
+        const auto columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const auto rows    = (count + columns - 1) / columns;
+
+        int index = 0;
+        for (auto& [sourceId, tile] : _tiles)
+        {
+            const auto column = index % columns;
+            const auto row    = index / columns;
+            tile.rect = QRect{QPoint{column * width() / columns, row * height() / rows},
+                              QPoint{(column + 1) * width() / columns - 1, (row + 1) * height() / rows - 1}};
+            ++index;
+        }
+
+        update();
+    }
+
+    void ServerWindow::resizeEvent(QResizeEvent* event)
+    {
+        QWidget::resizeEvent(event);
+        layoutTiles();
+    }
+
+    // Only tiles in the dirty region are painted, each frame keeps its aspect ratio within its tile.
+    void ServerWindow::paintEvent(QPaintEvent* event)
+    {
+        QPainter painter{this};
+        painter.fillRect(event->rect(), Qt::black);
+
+        for (const auto& [sourceId, tile] : _tiles)
+        {
+            if (!event->region().intersects(tile.rect))
+            {
+                continue;
+            }
+
+            if (tile.frame.width != 0 && tile.frame.height != 0)
+            {
+                const QImage image(tile.frame.rgb.data(),
+                                   static_cast<int>(tile.frame.width),
+                                   static_cast<int>(tile.frame.height),
+                                   static_cast<int>(tile.frame.width * 3),
+                                   QImage::Format_RGB888);
+
+                QRect target{QPoint{}, image.size().scaled(tile.rect.size(), Qt::KeepAspectRatio)};
+                target.moveCenter(tile.rect.center());
+                painter.drawImage(target, image);
+            }
 
-        setPixmap(std::move(image));
-        setScaledContents(true);
-        setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
+            painter.setPen(Qt::white);
+            painter.drawText(tile.rect.adjusted(6, 4, -6, -4), Qt::AlignTop | Qt::AlignLeft,
+                             QString{"Source %1"}.arg(sourceId));
+        }
     }
 
-}  // namespace ui
\ No newline at end of file
+}  // namespace ui
@@ -1,27 +1,52 @@
 #pragma once
 
 #include <QApplication>
-#include <QLabel>
-#include <QMainWindow>
-#include <filesystem>
+#include <QTimer>
+#include <QWidget>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "img/Jpeg.hpp"
 
 namespace ui
 {
-    class ServerWindow : public QLabel
+    // One tile per source ID, each showing the latest frame of its source. Frames are handed over as JPEG and only
+    // the latest one per source is kept; a timer running at `maxFps` decodes it at tile resolution and repaints the
+    // tiles that changed, so the UI costs the same whether a camera sends 1 or 60 frames per second.
+    class ServerWindow : public QWidget
     {
         Q_OBJECT
     public:
-        ServerWindow(QWidget* parent = nullptr);
+        explicit ServerWindow(unsigned maxFps = 10, QWidget* parent = nullptr);
         ~ServerWindow();
 
-        void asyncImageUpdate(const std::filesystem::path& imagePath);
+        // Thread-safe, copies `jpeg`.
+        void asyncFrameUpdate(std::uint32_t sourceId, std::string_view jpeg);
         void cancel(); //FIXME
 
     signals:
-        void requestUpdate(const std::filesystem::path& imagePath);
         void requestQuit();
 
-    private slots:
-        void updateImage(const std::filesystem::path& imagePath);
+    protected:
+        void paintEvent(QPaintEvent* event) override;
+        void resizeEvent(QResizeEvent* event) override;
+
+    private:
+        struct Tile
+        {
+            QRect rect;
+            img::Image frame;
+        };
+
+        void refresh();
+        void layoutTiles();
+
+        std::mutex _mutex;
+        std::map<std::uint32_t, std::string> _latest;  // Not decoded yet, guarded by `_mutex`
+        std::map<std::uint32_t, Tile> _tiles;
+        QTimer _refresh;
     };
 }  // namespace ui